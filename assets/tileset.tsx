@@ -0,0 +1,4 @@
+<?xml version="1.0" encoding="UTF-8"?>
+<tileset version="1.10" tiledversion="1.10.2" name="tileset" tilewidth="16" tileheight="16" tilecount="625" columns="25">
+ <image source="tileset.bmp" width="400" height="400"/>
+</tileset>
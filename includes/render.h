@@ -6,7 +6,12 @@
 
 #include "utils.h"
 
-#define MAX_FRAMES_LOADED 2
+/* Upper bound of `RenderContext.frames_in_flight`, every frame needs a bit in
+ * `Object.stale_frames` */
+#define MAX_FRAMES_LOADED 4
+
+/* Frames in flight when none were asked for */
+#define DEFAULT_FRAMES_LOADED 2
 
 /* One of the most important goals of Vulkan when it was created, is that
  * multi-GPU can be done “manually”. This is done by creating a VkDevice for
@@ -24,6 +29,56 @@ typedef struct Vertex {
     f32 tex[2];
 } __attribute__ ((aligned (8))) Vertex;
 
+/* Per-instance data sent to the vertex shader for every tile
+ *
+ * pos is in location 1
+ * tile and layer are in location 2 */
+typedef struct {
+    /* Position of the tile on the level's grid */
+    u16 pos[2];
+
+    /* Index of the tile's sprite in the atlas */
+    u16 tile;
+
+    /* Index of the layer the tile belongs to */
+    u16 layer;
+} TileInstance;
+
+/* Part of the world shown on screen, read by the vertex stage of both
+ * pipelines from a uniform buffer so recorded draws stay valid as it moves.
+ *
+ * The world is measured in tiles, the level's grid starts at the origin. */
+typedef struct {
+    /* World position shown in the top-left corner of the screen */
+    f32 pos[2];
+
+    /* Size of a tile in normalized device coordinates */
+    f32 scale[2];
+} Camera;
+
+/* Number of tiles that fit across the screen */
+#define VIEW_WIDTH 32
+
+/* Number of tiles that fit down the screen */
+#define VIEW_HEIGHT 18
+
+/* Push constants used by the instanced tile pipeline */
+typedef struct {
+    /* Number of sprites along each axis of the atlas */
+    u32 atlas_size[2];
+} TileGrid;
+
+/* Push constants used by the fragment shader in bindless mode, placed right
+ * after `TileGrid` */
+typedef struct {
+    /* Index of the sampled texture in the bindless texture array */
+    u32 texture;
+} DrawConstants;
+
+/* Upper bound on the number of textures in the bindless texture array,
+ * lowered to what the device supports */
+#define BINDLESS_TEXTURE_COUNT 4096
+
 typedef struct {
     /* Interface to send images to the screen.
      * List of images, accessible by the operating system for display */
@@ -73,46 +128,828 @@ typedef struct {
     VkFence renderers_busy;
 } Synchronization;
 
+/* Size of a single block of GPU memory that resources are sub-allocated from.
+ * Resources larger than a block are given a block of their own. */
+#define MEMORY_BLOCK_SIZE (32 * 1024 * 1024)
+
+/* Range of bytes inside of a `MemoryBlock` */
 typedef struct {
-    /* Memory on the GPU that holds the `texture` */
+    VkDeviceSize offset;
+    VkDeviceSize size;
+} MemoryRange;
+
+typedef struct {
+    /* Single `vkAllocateMemory` allocation shared by many resources.
+     * VK_NULL_HANDLE when the block has been released. */
     VkDeviceMemory mem;
 
+    /* Size in bytes of `mem` */
+    VkDeviceSize size;
+
+    /* Bytes of `mem` handed out to resources, excluding alignment padding */
+    VkDeviceSize used;
+
+    /* Index into `VkPhysicalDeviceMemoryProperties.memoryTypes` */
+    u32 type;
+
+    /* Whether the block holds buffers or optimally tiled images.
+     *
+     * Linear and optimal resources never share a block, so neighbouring
+     * resources never have to be padded to `bufferImageGranularity`. */
+    bool linear;
+
+    /* Address of `mem` if it's host visible, mapped for the block's lifetime */
+    u8 *mapped;
+
+    /* Unused ranges of `mem` sorted by offset, neighbours are always merged */
+    MemoryRange *free;
+
+    /* Number of ranges in `free` */
+    u32 free_count;
+
+    /* Number of ranges allocated in `free` */
+    u32 free_alloc_count;
+
+    /* Number of live allocations inside of the block */
+    u32 allocation_count;
+} MemoryBlock;
+
+/* Sub-allocates buffers and images from a few large blocks of memory per
+ * memory type, keeping far below `maxMemoryAllocationCount` */
+typedef struct {
+    /* Blocks of every memory type, released blocks are reused */
+    MemoryBlock *blocks;
+
+    /* Number of blocks in `blocks` */
+    u32 block_count;
+} GpuAllocator;
+
+/* Region of a `MemoryBlock` backing a single resource */
+typedef struct {
+    /* Memory of the block the resource is bound to */
+    VkDeviceMemory mem;
+
+    /* Offset of the resource into `mem` */
+    VkDeviceSize offset;
+
+    /* Size in bytes requested by the resource */
+    VkDeviceSize size;
+
+    /* Host address of the resource, NULL if it isn't host visible */
+    void *mapped;
+
+    /* Index into `GpuAllocator.blocks` */
+    u32 block;
+} GpuAllocation;
+
+/* Snapshot of the allocator's memory usage */
+typedef struct {
+    /* Number of live `vkAllocateMemory` allocations */
+    u32 block_count;
+
+    /* Number of resources bound to the blocks */
+    u32 allocation_count;
+
+    /* Bytes allocated from the driver */
+    VkDeviceSize reserved;
+
+    /* Bytes handed out to resources */
+    VkDeviceSize used;
+
+    /* Number of free ranges over every block */
+    u32 free_range_count;
+
+    /* Largest free range of any block */
+    VkDeviceSize largest_free_range;
+} GpuAllocatorStats;
+
+typedef struct {
+    /* Memory on the GPU that holds the `texture` */
+    GpuAllocation mem;
+
     /* Reference to the memory in `texture_memory` */
     VkImage image;
 
     /* Additional metadata and resources references required by shaders */
     VkImageView view;
 
-    /* Descriptor bindings for every frame */
-    VkDescriptorSet desc_sets[MAX_FRAMES_LOADED];
+    /* Descriptor bindings for every frame in flight, unused in bindless
+     * mode */
+    VkDescriptorSet *desc_sets;
 
-    /* Method of reading images, applying filters and other transformations */
+    /* Slot of the texture in the bindless texture array */
+    u32 index;
+
+    /* Method of reading images, applying filters and other transformations,
+     * owned by the sampler cache */
     VkSampler sampler;
 } Texture;
 
-/* Objects could be stored in a linked list.
- * However as every member of Object and it's members are just pointers
- * I feel like the cost of copying over the struct on appends isn't too bad */
+/* Texture loaded from a region of an image on disk, shared by everything
+ * that references the same path and region */
 typedef struct {
-    /* Unique texture identifier */
-    u32 ident;
+    /* `hash` of the path combined with the region */
+    u32 key;
+
+    /* Path of the image the texture was loaded from */
+    char *path;
+
+    /* Part of the image uploaded, empty for the whole image */
+    SDL_Rect region;
+
+    /* Number of users of `texture`, unreferenced textures stay loaded */
+    u32 refs;
+
+    /* The shared GPU image, sampler and descriptors */
+    Texture texture;
+} CachedTexture;
+
+/* Open addressed table of every texture loaded from disk by
+ * `texture_acquire`, looked up by `CachedTexture.key` */
+typedef struct {
+    /* Slots of the table, a power of two in length. Textures are allocated
+     * separately so they don't move when the table grows */
+    CachedTexture **entries;
+
+    /* Number of occupied slots in `entries` */
+    u32 count;
+
+    /* Number of slots in `entries` */
+    u32 capacity;
+} TextureCache;
+
+/* First bytes of an asset pack, "PAK" followed by a zero */
+#define PACK_MAGIC 0x004B4150
+
+/* Bumped whenever the layout of an asset pack changes */
+#define PACK_VERSION 1
+
+/* Alignment of the pixels of every image in an asset pack */
+#define PACK_ALIGNMENT 64
+
+/* Start of an asset pack built by `tools/assetpack.c`, followed by the
+ * directory at `directory_offset`.
+ *
+ * Like a compiled level it's in the byte order of the machine that built it
+ * and read in place once mapped into memory. */
+typedef struct {
+    /* Always `PACK_MAGIC` */
+    u32 magic;
+
+    /* `PACK_VERSION` the pack was built with */
+    u32 version;
+
+    /* Number of slots of the directory, a power of two */
+    u32 slot_count;
+
+    /* Number of images in the pack */
+    u32 image_count;
+
+    /* Offset of the directory, an open addressed table of `PackEntry`
+     * indexed by the `hash` of each image's path */
+    u64 directory_offset;
+} PackHeader;
+
+/* Image in an asset pack, stored as tightly packed rows of
+ * `SDL_PIXELFORMAT_BGRA32` which matches `VK_FORMAT_B8G8R8A8_SRGB`.
+ *
+ * Pixels aren't block compressed: the atlas is sampled texel by texel, where
+ * the 4x4 block artifacts of BC formats would show on 16px sprites, and
+ * the images are small enough that they upload in well under a frame. */
+typedef struct {
+    /* `hash` of the path the image was packed from */
+    u32 key;
+
+    /* Length of the path, zero for empty slots */
+    u32 path_length;
+
+    /* Offset of the path, followed by a null terminator */
+    u64 path_offset;
+
+    /* Size of the image in pixels */
+    u32 size[2];
+
+    /* Offset of the pixels, aligned to `PACK_ALIGNMENT` */
+    u64 pixels_offset;
+} PackEntry;
+
+/* Asset pack mapped into memory, images are uploaded straight from it */
+typedef struct {
+    /* The pack file, nothing is mapped when the pack wasn't found */
+    MappedFile file;
+
+    /* Header at the start of `file` */
+    const PackHeader *header;
+
+    /* Slots of the directory within `file` */
+    const PackEntry *slots;
+} AssetPack;
+
+typedef struct {
+    /* Parameters the sampler was created with */
+    VkSamplerCreateInfo info;
+
+    /* Hash of the parameters in `info` */
+    u32 hash;
+
+    /* Sampler shared by every texture using `info`, null for empty slots */
+    VkSampler sampler;
+} SamplerEntry;
+
+/* Open addressed table of every distinct sampler that was created */
+typedef struct {
+    /* Slots of the table, a power of two in length */
+    SamplerEntry *entries;
+
+    /* Number of occupied slots in `entries` */
+    u32 count;
+
+    /* Number of slots in `entries` */
+    u32 capacity;
+} SamplerCache;
+
+typedef struct {
+    /* The whole tileset uploaded once as a single texture */
+    Texture texture;
+
+    /* Number of sprites along the x-axis of the tileset */
+    u32 columns;
+
+    /* Number of sprites along the y-axis of the tileset */
+    u32 rows;
+} Atlas;
+
+/* Properties of a sprite in the tileset, shared by every tile using it */
+typedef enum {
+    /* Movers can't overlap the tile */
+    TILE_SOLID = 1 << 0,
+} TileFlags;
+
+/* Uniform grid over the level with a cell per tile, marking every cell
+ * covered by a solid tile of any layer */
+typedef struct {
+    /* Whether each cell is solid, row by row */
+    u8 *cells;
+
+    /* Number of cells along each axis */
+    u32 size[2];
+
+    /* Size of a single cell in normalized device coordinates */
+    f32 cell_size[2];
+
+    /* Position of the top-left corner of the first cell */
+    f32 origin[2];
+} CollisionGrid;
+
+/* Quads sharing a single texture, drawn with a single draw call.
+ *
+ * Every quad is made up of 4 consecutive vertices which are indexed by the
+ * shared index buffer in `RenderContext.indices`. */
+typedef struct {
+    /* Vertices of every quad in the batch */
+    Vertex *vertices;
+
+    /* Number of quads in the batch */
+    u32 quad_count;
+
+    /* Number of quads allocated in `vertices` */
+    u32 quad_alloc_count;
+
+    /* Memory on the GPU that holds the `vertices` */
+    GpuAllocation vertices_mem;
+
+    /* Reference to the memory in `vertices_mem` */
+    VkBuffer vertices_buf;
+
+    /* Texture sampled by every quad in the batch */
+    Texture *texture;
+} SpriteBatch;
+
+/* Side length in tiles of the squares a layer is streamed and culled in */
+#define CHUNK_SIZE 16
+
+/* Chunks past each edge of the screen that are loaded ahead of time, so
+ * they're resident before they scroll into view */
+#define STREAM_DISTANCE 1
+
+/* First bytes of a compiled level, "LVL" followed by a zero */
+#define LEVEL_MAGIC 0x004C564C
+
+/* Bumped whenever the layout of a compiled level changes */
+#define LEVEL_VERSION 2
+
+/* Start of a level compiled by `tools/levelc.c`, followed by the sections
+ * at the offsets below.
+ *
+ * Everything is in the byte order of the machine that compiled it and every
+ * section is aligned to 8 bytes, so the file is read in place once it's
+ * mapped into memory. */
+typedef struct {
+    /* Always `LEVEL_MAGIC` */
+    u32 magic;
+
+    /* `LEVEL_VERSION` the level was compiled with */
+    u32 version;
+
+    /* Size of the level in tiles, its widest layer by its tallest one */
+    u32 size[2];
+
+    /* Number of chunks along each axis, covering all of `size` */
+    u32 chunks[2];
+
+    /* Number of tile layers, in the order they're drawn */
+    u32 layer_count;
+
+    /* `CHUNK_SIZE` the tiles were grouped with */
+    u32 chunk_size;
+
+    /* Number of sprites along each axis of the tileset, tiles only index
+     * sprites within it */
+    u32 atlas_size[2];
+
+    /* Size in pixels of a single sprite of the tileset */
+    u32 tile_size[2];
+
+    /* Offset of the path of the tileset's image, null terminated */
+    u64 tileset_offset;
+
+    /* Offset of the `TileFlags` of every cell of the level, row by row,
+     * combined over all layers */
+    u64 flags_offset;
+
+    /* Offset of the `LevelUv` of every sprite of the tileset */
+    u64 uvs_offset;
+
+    /* Offset of the `LevelChunk` of every chunk, layer by layer and then
+     * row by row */
+    u64 chunks_offset;
+} LevelHeader;
+
+/* Region of the tileset covered by a sprite */
+typedef struct {
+    /* Texture coordinates of the sprite's top-left corner */
+    f32 min[2];
+
+    /* Texture coordinates of the sprite's bottom-right corner */
+    f32 max[2];
+} LevelUv;
+
+/* Tiles of a single chunk of a compiled level */
+typedef struct {
+    /* Offset of the chunk's `TileInstance`s, stored back to back */
+    u64 offset;
+
+    /* Number of tiles in the chunk, zero for chunks without any */
+    u32 tile_count;
+
+    /* Keeps the entries 8 byte aligned */
+    u32 padding;
+} LevelChunk;
+
+/* Compiled level mapped into memory, chunks hand out their tiles straight
+ * from it without copying them */
+typedef struct {
+    /* The level file */
+    MappedFile file;
+
+    /* Header at the start of `file` */
+    const LevelHeader *header;
+
+    /* Path of the tileset's image within `file` */
+    const char *tileset;
+
+    /* `TileFlags` of every cell within `file` */
+    const u8 *flags;
+
+    /* Texture coordinates of every sprite within `file` */
+    const LevelUv *uvs;
+
+    /* Every chunk of every layer within `file` */
+    const LevelChunk *chunks;
+} Level;
+
+/* Tiles of a layer within a single `CHUNK_SIZE` square of the level,
+ * loaded, drawn and evicted as a whole */
+typedef struct {
+    /* Position of the square on the level, in chunks */
+    u32 pos[2];
+
+    /* Whether the tiles have arrived from the streaming thread */
+    bool loaded;
+
+    /* `RenderContext.frame_count` when the chunk was evicted, it's
+     * destroyed once no frame in flight can draw it anymore */
+    u64 evicted_frame;
+
+    /* Every non-empty square of the chunk, within `RenderContext.level`
+     * unless some had to be dropped */
+    const TileInstance *tiles;
+
+    /* Copy of the valid tiles when the level had tiles outside of the
+     * tileset or level, NULL otherwise */
+    TileInstance *kept_tiles;
+
+    /* Number of tiles in the chunk */
+    u32 tile_count;
+
+    /* Memory on the GPU that holds the `tiles` */
+    GpuAllocation tiles_mem;
+
+    /* Reference to the memory in `tiles_mem`, read once per instance */
+    VkBuffer tiles_buf;
+
+    /* Quads expanded on the CPU from `tiles` when instancing is disabled */
+    SpriteBatch batch;
+} TileChunk;
+
+typedef struct {
+    /* Every chunk of the layer within `RenderContext.level`, row by row */
+    const LevelChunk *level_chunks;
+
+    /* Size of the level in tiles */
+    u32 size[2];
+
+    /* Chunks that are resident or being read by the streaming thread */
+    TileChunk *chunks;
+
+    /* Number of chunks in `chunks` */
+    u32 chunk_count;
+
+    /* Number of chunks allocated in `chunks` */
+    u32 chunk_alloc_count;
+
+    /* Index of the layer's first chunk within a frame's indirect draws */
+    u32 draw_offset;
+} TileLayer;
 
-    /* Vertices of the object to be renderer */
+/* Chunk of the level paged in by the streaming thread */
+typedef struct {
+    /* Index of the chunk's layer in `RenderContext.layers` */
+    u32 layer;
+
+    /* Position of the chunk, in chunks */
+    u32 pos[2];
+
+    /* Tiles of the chunk within `RenderContext.level` */
+    const TileInstance *tiles;
+
+    /* Number of tiles in `tiles` */
+    u32 tile_count;
+} ChunkRequest;
+
+/* Background thread paging in chunks of the mapped level as the camera
+ * approaches them, so the main thread never waits on the disk. GPU
+ * resources are only ever touched by the main thread. */
+typedef struct {
+    /* Thread running `stream_worker` */
+    SDL_Thread *thread;
+
+    /* Guards the queues, `busy` and `quit` */
+    SDL_mutex *lock;
+
+    /* Signalled when requests are queued or the thread should stop */
+    SDL_cond *wake;
+
+    /* Signalled whenever the thread finishes a request */
+    SDL_cond *done;
+
+    /* Chunks waiting to be paged in */
+    ChunkRequest *requests;
+
+    /* Number of requests in `requests` */
+    u32 request_count;
+
+    /* Number of requests allocated in `requests` */
+    u32 request_alloc_count;
+
+    /* Chunks paged in and waiting to be uploaded by the main thread */
+    ChunkRequest *results;
+
+    /* Number of requests in `results` */
+    u32 result_count;
+
+    /* Number of requests allocated in `results` */
+    u32 result_alloc_count;
+
+    /* Number of requests taken by the thread that aren't in `results` yet */
+    u32 busy;
+
+    /* Indicator that the thread should exit ASAP */
+    bool quit;
+
+    /* Evicted chunks waiting for the frames in flight to finish with them,
+     * only touched by the main thread */
+    TileChunk *retired;
+
+    /* Number of chunks in `retired` */
+    u32 retired_count;
+
+    /* Number of chunks allocated in `retired` */
+    u32 retired_alloc_count;
+} ChunkStreamer;
+
+/* Render data of an object, only touched when it's drawn or moved.
+ *
+ * Data read every frame by game logic lives in the other arrays of
+ * `ObjectStore` at the same index. */
+typedef struct {
+    /* Vertices of the object where it was created */
     Vertex *vertices;
 
+    /* Distance from `vertices` the object is drawn at, interpolated between
+     * the last two simulation ticks */
+    f32 offset[2];
+
     /* Number of vertices to be renderer */
     u32 vertices_count;
 
-    /* Memory on the GPU that holds the `vertices` */
-    VkDeviceMemory vertices_mem;
+    /* Host visible memory that holds a copy of `vertices` for every frame in
+     * flight, written to directly by the CPU */
+    GpuAllocation vertices_mem;
 
-    /* Reference to the memory in `vertex_memory` */
+    /* Reference to the memory in `vertices_mem` */
     VkBuffer vertices_buf;
 
-    /* Everything related to the object's texture */
-    Texture texture;
+    /* Bit for every frame in flight whose copy of `vertices` is outdated */
+    u32 stale_frames;
 } Object;
 
+/* Distance an object has been moved since it was created */
+typedef struct {
+    f32 pos[2];
+} ObjectTransform;
+
+/* Axis aligned box enclosing every vertex of an object */
+typedef struct {
+    /* Top-left corner */
+    f32 min[2];
+
+    /* Bottom-right corner */
+    f32 max[2];
+} ObjectBounds;
+
+/* Two objects whose bounding boxes overlap, by dense index with `a < b` */
+typedef struct {
+    u32 a;
+    u32 b;
+} CollisionPair;
+
+/* Bounding box interval of an object along the sweep axis */
+typedef struct {
+    /* Left edge of the box */
+    f32 min;
+
+    /* Right edge of the box */
+    f32 max;
+
+    /* Dense index of the object the box belongs to */
+    u32 index;
+} BroadphaseEntry;
+
+/* Sort and sweep over the x-axis of every object's bounding box.
+ *
+ * Entries stay sorted between updates, so objects that moved a little only
+ * need a couple of swaps to be sorted again. Nothing in the game reacts to
+ * overlapping objects yet, it's only run by `tools/broadphase_bench.c`. */
+typedef struct {
+    /* Intervals of every object sorted by `min` */
+    BroadphaseEntry *entries;
+
+    /* Number of objects in `entries` */
+    u32 entry_count;
+
+    /* Number of entries allocated in `entries` */
+    u32 entry_alloc_count;
+
+    /* Overlapping objects found by the last update */
+    CollisionPair *pairs;
+
+    /* Number of pairs in `pairs` */
+    u32 pair_count;
+
+    /* Number of pairs allocated in `pairs` */
+    u32 pair_alloc_count;
+} Broadphase;
+
+/* Index into the dense arrays of `ObjectStore` of a missing object */
+#define OBJECT_NONE UINT32_MAX
+
+/* Stable reference to an object that stays valid while objects are created
+ * and destroyed, unlike an index into the dense arrays of `ObjectStore` */
+typedef struct {
+    /* Slot of the object in `ObjectStore.slots` */
+    u32 index;
+
+    /* Generation of the slot when the handle was made, 0 is never valid */
+    u32 generation;
+} ObjectHandle;
+
+typedef struct {
+    /* Position of the object in the dense arrays, `OBJECT_NONE` when free */
+    u32 dense;
+
+    /* Incremented every time the slot is freed, invalidating handles to the
+     * previous occupant */
+    u32 generation;
+} ObjectSlot;
+
+/* Entry of the `ident` to handle index, empty when the generation is 0 */
+typedef struct {
+    /* Identifier the object was created with */
+    u32 ident;
+
+    /* Most recently created object with `ident` */
+    ObjectHandle handle;
+} ObjectIndexEntry;
+
+/* Every object stored as parallel dense arrays, so that loops touching a
+ * single property of every object walk contiguous memory.
+ *
+ * Handles go through `slots` to find the object's dense index, destroying
+ * an object moves the last one into it's place. */
+typedef struct {
+    /* Indirection from handles to the dense arrays */
+    ObjectSlot *slots;
+
+    /* Number of slots that have ever been used in `slots` */
+    u32 slot_count;
+
+    /* Number of slots allocated in `slots` */
+    u32 slot_alloc_count;
+
+    /* Freed slots to be reused before growing `slots` */
+    u32 *free_slots;
+
+    /* Number of slots in `free_slots` */
+    u32 free_count;
+
+    /* Number of objects in every dense array */
+    u32 count;
+
+    /* Number of objects allocated in every dense array */
+    u32 alloc_count;
+
+    /* Unique texture identifier of every object */
+    u32 *idents;
+
+    /* Slot pointing to every object */
+    u32 *owners;
+
+    /* Order every object was created in, which destroying objects doesn't
+     * preserve in the dense arrays */
+    u64 *sequences;
+
+    /* Sequence number of the next object created */
+    u64 next_sequence;
+
+    /* Movement of every object */
+    ObjectTransform *transforms;
+
+    /* Movement of every object as of the previous simulation tick */
+    ObjectTransform *previous;
+
+    /* Bounding box of every object */
+    ObjectBounds *bounds;
+
+    /* Texture sampled by every object, shared through the texture cache */
+    Texture **textures;
+
+    /* Vertex buffers of every object */
+    Object *objects;
+
+    /* Open addressed table from an object's `ident` to it's handle */
+    ObjectIndexEntry *index;
+
+    /* Number of entries in `index` that are occupied */
+    u32 index_count;
+
+    /* Number of entries in `index`, a power of two */
+    u32 index_capacity;
+} ObjectStore;
+
+typedef enum {
+    UPLOAD_BUFFER,
+    UPLOAD_IMAGE
+} UploadType;
+
+/* Transfer recorded by the upload context, waiting to be submitted */
+typedef struct {
+    /* Whether `dst_buf` or `dst_image` is written to */
+    UploadType type;
+
+    /* Host visible buffer holding the data, usually the staging ring */
+    VkBuffer src;
+
+    /* Offset of the data into `src` */
+    VkDeviceSize src_offset;
+
+    /* Memory of `src` if it's owned by the upload, released once completed */
+    GpuAllocation src_mem;
+
+    /* Whether `src` was created for this upload alone, as the data didn't
+     * fit in the staging ring */
+    bool owned;
+
+    /* Destination of a UPLOAD_BUFFER transfer */
+    VkBuffer dst_buf;
+
+    /* Number of bytes copied by a UPLOAD_BUFFER transfer */
+    VkDeviceSize size;
+
+    /* Destination of a UPLOAD_IMAGE transfer */
+    VkImage dst_image;
+
+    /* Dimensions of `dst_image` */
+    u32 width, height;
+} Upload;
+
+/* Size of the persistently mapped buffer every upload is staged in */
+#define STAGING_RING_SIZE (16 * 1024 * 1024)
+
+/* Host visible buffer uploads are written to before being copied to the GPU.
+ *
+ * Space is handed out in submission order, a region stretching from `tail`
+ * to `submitted` is read by the batch in flight and reclaimed once its fence
+ * is signaled.
+ *
+ * The ring isn't split into a region per frame in flight: uploads are
+ * submitted to the transfer queue in batches of their own, often outside
+ * of any frame while loading, so a region is reclaimed by the fence of the
+ * batch that read it rather than by a frame's fence. Only one batch is in
+ * flight at a time, so running out of space waits for it to complete. */
+typedef struct {
+    /* Buffer transfers are copied from */
+    VkBuffer buf;
+
+    /* Memory of `buf`, mapped for the ring's lifetime */
+    GpuAllocation mem;
+
+    /* Size in bytes of `buf` */
+    VkDeviceSize size;
+
+    /* Offset the next region is written at */
+    VkDeviceSize head;
+
+    /* Start of the oldest region that might still be read by the GPU */
+    VkDeviceSize tail;
+
+    /* End of the regions read by the batch in flight */
+    VkDeviceSize submitted;
+} StagingRing;
+
+/* Collects transfers to the GPU so they can be recorded into a single
+ * command buffer and submitted at once to the transfer queue. */
+typedef struct {
+    /* Pool of the transfer queue family `cmd_buf` is allocated from */
+    VkCommandPool cmd_pool;
+
+    /* Command buffer every transfer of a batch is recorded into */
+    VkCommandBuffer cmd_buf;
+
+    /* Signaled once a submitted batch has completed */
+    VkFence fence;
+
+    /* Whether a submitted batch is still owning `cmd_buf` and `uploads` */
+    bool in_flight;
+
+    /* Signaled by a batch submitted by `vk_upload_end`, waited on by the next
+     * frame before it reads any of the uploaded resources */
+    VkSemaphore semaphore;
+
+    /* Whether the next frame has to wait on `semaphore` */
+    bool semaphore_pending;
+
+    /* Barriers acquiring uploaded buffers from the transfer queue family,
+     * recorded at the start of the next frame */
+    VkBufferMemoryBarrier *buffer_acquires;
+
+    /* Number of barriers in `buffer_acquires` */
+    u32 buffer_acquire_count;
+
+    /* Barriers acquiring uploaded images from the transfer queue family,
+     * recorded at the start of the next frame */
+    VkImageMemoryBarrier *image_acquires;
+
+    /* Number of barriers in `image_acquires` */
+    u32 image_acquire_count;
+
+    /* Memory every transfer is staged in */
+    StagingRing staging;
+
+    /* Transfers recorded since the last flush */
+    Upload *uploads;
+
+    /* Number of transfers in `uploads` */
+    u32 upload_count;
+
+    /* Number of transfers allocated in `uploads` */
+    u32 upload_alloc_count;
+
+    /* Whether transfers are held until `vk_upload_end`, otherwise every
+     * transfer is submitted and waited on by itself */
+    bool batching;
+} UploadContext;
+
 typedef struct {
     /* SDL application state */
     SDL_Window *window;
@@ -135,7 +972,15 @@ typedef struct {
     /* Index of the queue family that supports graphics commands */
     u32 queue_family;
 
-    /* Option for different types of vsync or none at all */
+    /* Queue that uploads are submitted to, same as `queue` if the device
+     * doesn't expose a dedicated transfer queue family */
+    VkQueue transfer_queue;
+
+    /* Index of the queue family of `transfer_queue` */
+    u32 transfer_family;
+
+    /* Option for different types of vsync or none at all, FIFO is used when
+     * the surface doesn't support it */
     VkPresentModeKHR present_mode;
 
     /* Information related to validation layers */
@@ -159,6 +1004,21 @@ typedef struct {
     /* Information of the required sequence of operations for doing a draw call */
     VkPipeline pipeline;
 
+    /* Variant of `pipeline` that draws tiles from per-instance data */
+    VkPipeline tile_pipeline;
+
+    /* Whether tile layers are drawn instanced or as CPU expanded batches */
+    bool instancing;
+
+    /* Whether textures are indexed from a single descriptor array */
+    bool bindless;
+
+    /* Frames a second `event_loop` is paced to, 0 when uncapped */
+    u32 target_fps;
+
+    /* Number of swapchain images asked for, 0 to pick automatically */
+    u32 swapchain_images;
+
     /* Collection of attachments, subpasses, and dependencies between the subpasses */
     VkRenderPass render_pass;
 
@@ -177,80 +1037,160 @@ typedef struct {
     /* Vertex shader code with an entry points */
     VkShaderModule vert;
 
+    /* Instanced tile vertex shader code with an entry points */
+    VkShaderModule tile_vert;
+
     /* Fragment shader code with an entry points */
     VkShaderModule frag;
 
     /* Pool from which command buffers are allocated from */
     VkCommandPool cmd_pool;
 
-    /* Commands to be submitted to the device queue */
-    VkCommandBuffer cmd_bufs[MAX_FRAMES_LOADED];
+    /* Commands to be submitted to the device queue, one per frame in flight */
+    VkCommandBuffer *cmd_bufs;
+
+    /* Synchronization objects required by `vk_engine_render`, one per frame
+     * in flight */
+    Synchronization *sync;
+
+    /* Number of frames the CPU may record ahead of the GPU, between 1 and
+     * `MAX_FRAMES_LOADED` */
+    u32 frames_in_flight;
+
+    /* Secondary command buffers drawing the tile layers, one per frame in
+     * flight and only re-recorded once outdated */
+    VkCommandBuffer *static_bufs;
+
+    /* Secondary command buffers drawing objects, re-recorded every frame */
+    VkCommandBuffer *dynamic_bufs;
+
+    /* Bit for every frame in flight whose `static_bufs` entry is outdated */
+    u32 static_stale_frames;
 
-    /* Synchronization objects required by `vk_engine_render`. */
-    Synchronization sync[MAX_FRAMES_LOADED];
+    /* Pending transfers to the GPU */
+    UploadContext upload;
 
     /* Index of the current frame being renderer */
     u32 frame;
 
+    /* Number of frames `vk_engine_render` has started drawing */
+    u64 frame_count;
+
     /* Details related to allocating memory on the GPU */
     VkPhysicalDeviceMemoryProperties mem_prop;
 
     /* Details related to the GPU */
     VkPhysicalDeviceProperties dev_prop;
 
+    /* Blocks of GPU memory that every buffer and image is sub-allocated from */
+    GpuAllocator allocator;
+
+    /* Samplers shared between textures with the same parameters */
+    SamplerCache samplers;
+
+    /* Textures shared between objects loading the same image */
+    TextureCache textures;
+
+    /* Images converted ahead of time, read before going to disk */
+    AssetPack pack;
+
     /* Description on how a VkDescriptorSet should be created */
     VkDescriptorSetLayout desc_set_layout;
 
     /* Pool from which descriptor sets are allocated */
     VkDescriptorPool desc_pool;
 
+    /* Set holding every texture in bindless mode, shared by all frames */
+    VkDescriptorSet bindless_set;
+
+    /* Number of slots in the bindless texture array */
+    u32 bindless_capacity;
+
+    /* Number of slots of the bindless texture array ever handed out */
+    u32 bindless_count;
+
+    /* Slots released by destroyed textures, reused before new ones */
+    u32 *bindless_free;
+
+    /* Number of slots in `bindless_free` */
+    u32 bindless_free_count;
+
     /* Entities in the game to be rendered */
-    Object *objects;
+    ObjectStore objects;
+
+    /* Texture containing every sprite a level map can reference */
+    Atlas atlas;
+
+    /* Layout of the atlas, pushed to `tile.vert` */
+    TileGrid grid;
+
+    /* Part of the world being shown */
+    Camera camera;
+
+    /* Description of the set holding a frame's copy of `camera` */
+    VkDescriptorSetLayout camera_layout;
 
-    /* Number of entities to be rendered */
-    u32 object_count;
+    /* Pool from which `camera_sets` are allocated */
+    VkDescriptorPool camera_pool;
 
-    /* Number of entities allocated in `objects` */
-    u32 object_alloc_count;
+    /* Set for every frame in flight pointing at its copy of `camera` */
+    VkDescriptorSet *camera_sets;
 
-    /* Memory on the GPU that holds a `tile_staging_buf` */
-    VkDeviceMemory tile_staging_mem;
+    /* Memory on the GPU that holds the `camera_buf`, written by the CPU */
+    GpuAllocation camera_mem;
 
-    /* Intermediate buffer for writing 16x16 tile's vertices */
-    VkBuffer tile_staging_buf;
+    /* Copy of `camera` for every frame in flight */
+    VkBuffer camera_buf;
 
-    /* Memory address of `tile_staging_buf` */
-    void *tile_gpu_mem;
+    /* Distance in bytes between the copies in `camera_buf` */
+    VkDeviceSize camera_stride;
 
-    /* Memory on the GPU that holds a `player_staging_buf` */
-    VkDeviceMemory player_staging_mem;
+    /* Memory on the GPU that holds the `draws_buf`, written by the CPU */
+    GpuAllocation draws_mem;
 
-    /* Intermediate buffer for writing player's vertices */
-    VkBuffer player_staging_buf;
+    /* Indirect draw for every chunk of every layer and frame in flight,
+     * culled chunks draw no instances */
+    VkBuffer draws_buf;
 
-    /* Memory address of `player_staging_buf` */
-    void *player_gpu_mem;
+    /* Number of indirect draws of a single frame */
+    u32 draw_count;
 
-    /* Offsets into `vertices` */
-    u16 *indices;
+    /* Number of indirect draws of a single frame `draws_buf` has room for */
+    u32 draw_capacity;
+
+    /* Compiled level the tile layers and collision grid are loaded from */
+    Level level;
+
+    /* Solid cells of the level that movers collide against */
+    CollisionGrid collision;
+
+    /* Tile layers of the level map, drawn in order with a draw call per
+     * resident chunk */
+    TileLayer *layers;
+
+    /* Number of tile layers in `layers` */
+    u32 layer_count;
+
+    /* Loads and evicts the chunks of `layers` around the camera */
+    ChunkStreamer stream;
+
+    /* Offsets into `vertices`, 6 for every quad */
+    u32 *indices;
 
     /* Indices into `vertices` on what vertices to draw */
     u32 indices_count;
 
     /* Memory on the GPU that holds the `indices` */
-    VkDeviceMemory indices_mem;
+    GpuAllocation indices_mem;
 
     /* Reference to the memory in `indices_memory` */
     VkBuffer indices_buf;
 
-    /* Memory on the GPU that holds the `indices_staging_buf` */
-    VkDeviceMemory indices_staging_mem;
-
-    /* Intermediate buffer for writing to the indices on the GPU */
-    VkBuffer indices_staging_buf;
+    /* Memory on the GPU that holds the `quad_buf` */
+    GpuAllocation quad_mem;
 
-    /* Memory address of `indices_staging_buf` */
-    void *indices_gpu_mem;
+    /* Unit square that every tile instance is expanded from */
+    VkBuffer quad_buf;
 } RenderContext;
 
 typedef struct {
@@ -268,12 +1208,21 @@ typedef struct {
 
     /* Movement generated since last position update */
     f32 dx, dy;
+
+    /* Object moved around by the keyboard */
+    ObjectHandle player;
 } Game;
 
-typedef enum {
-    OBJECT_PLAYER,
-    OBJECT_TILE
-} ObjectType;
+bool vk_memory_alloc(RenderContext *ctx, VkMemoryRequirements reqs,
+                     VkMemoryPropertyFlags flags, bool linear,
+                     GpuAllocation *alloc);
+void vk_memory_free(RenderContext *ctx, GpuAllocation *alloc);
+void vk_allocator_stats(RenderContext *ctx, GpuAllocatorStats *stats);
+void vk_allocator_destroy(RenderContext *ctx);
+
+void vk_upload_begin(RenderContext *ctx);
+bool vk_upload_flush(RenderContext *ctx);
+bool vk_upload_end(RenderContext *ctx);
 
 void vk_engine_create(RenderContext *ctx);
 void vk_engine_destroy(RenderContext *ctx);
@@ -281,32 +1230,79 @@ void vk_engine_render(RenderContext *ctx);
 
 bool vk_descriptor_sets_create(RenderContext *ctx, Texture *tex);
 bool vk_image_sampler_create(RenderContext *ctx, Texture *tex);
+bool vk_atlas_sampler_create(RenderContext *ctx, Texture *tex);
 
-bool vk_image_create(RenderContext *ctx, Texture *tex, const char *path);
 bool vk_image_from_surface(RenderContext *ctx, Texture *tex, SDL_Surface *img);
+void vk_image_destroy(RenderContext *ctx, Texture *tex);
+void vk_texture_destroy(RenderContext *ctx, Texture *tex);
+bool vk_sampler_get(RenderContext *ctx, const VkSamplerCreateInfo *info,
+                    VkSampler *sampler);
+void vk_sampler_cache_destroy(RenderContext *ctx);
 
 bool vk_swapchain_recreate(RenderContext *ctx);
+void vk_static_layers_invalidate(RenderContext *ctx);
+
+bool vk_vertices_create(RenderContext *ctx, Object *obj);
+bool vk_vertices_update(RenderContext *ctx, Object *obj);
+
+bool vk_indices_create(RenderContext *ctx, u32 quad_count);
 
-bool vk_vertices_create(RenderContext *ctx, Object *obj, ObjectType type);
-bool vk_vertices_update(RenderContext *ctx, Object *obj, ObjectType type);
+bool vk_sprite_batch_create(RenderContext *ctx, SpriteBatch *batch);
+void vk_sprite_batch_destroy(RenderContext *ctx, SpriteBatch *batch);
 
-bool vk_indices_create(RenderContext *ctx);
-bool vk_indices_update(RenderContext *ctx);
+bool vk_tile_chunk_create(RenderContext *ctx, TileChunk *chunk);
+void vk_tile_chunk_destroy(RenderContext *ctx, TileChunk *chunk);
 
 void sdl_renderer_create(RenderContext *ctx);
 void sdl_renderer_destroy(RenderContext *ctx);
 
-bool level_map_load(RenderContext *ctx,
-                    const char *level_path,
-                    const char *tileset_path);
+bool level_atlas_load(RenderContext *ctx);
+void level_atlas_destroy(RenderContext *ctx);
+bool level_load(RenderContext *ctx, const char *path);
+void level_unload(RenderContext *ctx);
+void level_chunk_batch(RenderContext *ctx, TileChunk *chunk);
+void level_layers_destroy(RenderContext *ctx);
+
+bool level_stream_start(RenderContext *ctx);
+void level_stream(RenderContext *ctx);
+void level_stream_wait(RenderContext *ctx);
+void level_stream_stop(RenderContext *ctx);
+
+void sprite_batch_push(SpriteBatch *batch, f32 pos[4][2], f32 uv[2][2]);
 
-SDL_Surface *sdl_load_image(const char *path);
+SDL_Surface *sdl_load_image(RenderContext *ctx, const char *path);
 
-bool object_create(RenderContext *ctx, f32 pos[4][2], const char *img_path);
-void object_transform(Object *obj, f32 x, f32 y);
+bool asset_pack_load(RenderContext *ctx, const char *path);
+const PackEntry *asset_pack_find(RenderContext *ctx, const char *path);
+void asset_pack_unload(RenderContext *ctx);
+
+Texture *texture_acquire(RenderContext *ctx, const char *path,
+                         const SDL_Rect *region);
+void texture_release(RenderContext *ctx, Texture *tex);
+void textures_destroy(RenderContext *ctx);
+
+bool object_create(RenderContext *ctx, f32 pos[4][2], const char *img_path,
+                   ObjectHandle *handle);
+void object_transform(RenderContext *ctx, u32 dense, f32 x, f32 y);
+void objects_tick(RenderContext *ctx);
+void objects_interpolate(RenderContext *ctx, f32 alpha);
 void objects_destroy(RenderContext *ctx);
+void object_drawn_bounds(RenderContext *ctx, u32 dense, ObjectBounds *bounds);
+
+void camera_center(RenderContext *ctx, f32 x, f32 y);
+bool camera_sees(RenderContext *ctx, const ObjectBounds *bounds);
 
-Object *object_find(RenderContext *ctx, u32 ident);
+u32 object_get(RenderContext *ctx, ObjectHandle handle);
+ObjectHandle object_find(RenderContext *ctx, u32 ident);
+bool object_remove(RenderContext *ctx, ObjectHandle handle);
 bool object_find_destroy(RenderContext *ctx, u32 ident);
 
+void collision_grid_reserve(CollisionGrid *grid, u32 width, u32 height);
+bool collision_grid_solid(CollisionGrid *grid, i32 x, i32 y);
+void collision_sweep(CollisionGrid *grid, const ObjectBounds *box, f32 delta[2]);
+void collision_grid_destroy(CollisionGrid *grid);
+
+void broadphase_update(Broadphase *phase, const ObjectBounds *bounds, u32 count);
+void broadphase_destroy(Broadphase *phase);
+
 #endif // RENDER_H_
@@ -101,6 +101,9 @@ void breek();
 
 #define HASH(s)    ((u32)(H256(s,0,0)^(H256(s,0,0)>>16)))
 
+u32 hash(const char *str);
+u32 hash_bytes(const void *data, usize size);
+
 /* --------------------------------------------------------- */
 
 void *vmalloc(usize size);
@@ -108,10 +111,38 @@ void *vcalloc(usize size);
 void *vrealloc(void* ptr, usize size);
 
 void now(struct timespec *time);
+u64 now_ns();
 f64 time_elapsed(struct timespec *start);
 
+/* Spaces frames a fixed period apart on the monotonic clock */
+typedef struct {
+    /* Nanoseconds between frames, 0 when frames aren't paced */
+    u64 period;
+
+    /* Time at which the next frame should start */
+    u64 deadline;
+} FramePacer;
+
+void pacer_init(FramePacer *pacer, u32 fps);
+void pacer_wait(FramePacer *pacer);
+
 char *read_binary(const char *path, u32 *bytes_read);
 
+/* File mapped into memory, or read into the heap where mapping fails */
+typedef struct {
+    /* Contents of the file */
+    const u8 *data;
+
+    /* Size of `data` in bytes */
+    usize size;
+
+    /* Whether `data` is mapped rather than allocated */
+    bool mapped;
+} MappedFile;
+
+bool file_map(const char *path, MappedFile *file);
+void file_unmap(MappedFile *file);
+
 u32 clamp(u32 val, u32 min, u32 max);
 
 #endif // UTILS_H_
@@ -0,0 +1,305 @@
+#include "utils.h"
+#include "render.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/* Returns the first memory type that has every property in `flags`, or
+ * VK_MAX_MEMORY_TYPES if there is none. */
+u32 vk_find_memory_type(RenderContext *ctx, VkMemoryRequirements reqs,
+                        VkMemoryPropertyFlags flags) {
+
+    for (u32 idx = 0; idx < ctx->mem_prop.memoryTypeCount; idx++) {
+        VkMemoryPropertyFlags props;
+
+        props = ctx->mem_prop.memoryTypes[idx].propertyFlags;
+
+        if ((reqs.memoryTypeBits & (1 << idx)) && (props & flags) == flags)
+            return idx;
+    }
+
+    warn("failed to find any compatible memory type");
+    return VK_MAX_MEMORY_TYPES;
+}
+
+/* Inserts `range` into a block's free list at position `at`. */
+void memory_range_insert(MemoryBlock *block, u32 at, MemoryRange range) {
+    if (block->free_count == block->free_alloc_count) {
+        block->free_alloc_count = block->free_alloc_count * 2 + 8;
+        block->free = vrealloc(
+            block->free,
+            block->free_alloc_count * sizeof(MemoryRange)
+        );
+    }
+
+    memmove(
+        &block->free[at + 1],
+        &block->free[at],
+        (block->free_count - at) * sizeof(MemoryRange)
+    );
+
+    block->free[at] = range;
+    block->free_count++;
+}
+
+void memory_range_remove(MemoryBlock *block, u32 at) {
+    memmove(
+        &block->free[at],
+        &block->free[at + 1],
+        (block->free_count - at - 1) * sizeof(MemoryRange)
+    );
+
+    block->free_count--;
+}
+
+/* Carves `size` bytes aligned to `alignment` out of the first free range
+ * that fits (first-fit). Returns whether the block had any room. */
+bool memory_block_carve(MemoryBlock *block, VkDeviceSize size,
+                        VkDeviceSize alignment, VkDeviceSize *offset) {
+
+    for (u32 idx = 0; idx < block->free_count; idx++) {
+        MemoryRange range = block->free[idx];
+        VkDeviceSize start, padding, remainder;
+
+        start = (range.offset + alignment - 1) & ~(alignment - 1);
+        padding = start - range.offset;
+
+        if (padding + size > range.size)
+            continue;
+
+        remainder = range.size - padding - size;
+
+        // alignment padding stays in the free list in front of the resource
+        if (padding != 0 && remainder != 0) {
+            block->free[idx].size = padding;
+            memory_range_insert(block, idx + 1, (MemoryRange) {
+                .offset = start + size,
+                .size = remainder
+            });
+        } else if (padding != 0) {
+            block->free[idx].size = padding;
+        } else if (remainder != 0) {
+            block->free[idx].offset = start + size;
+            block->free[idx].size = remainder;
+        } else {
+            memory_range_remove(block, idx);
+        }
+
+        block->used += size;
+        block->allocation_count++;
+        *offset = start;
+
+        return true;
+    }
+
+    return false;
+}
+
+/* Allocates a new block from the driver, reusing the slot of a released
+ * block if there is one. */
+MemoryBlock *memory_block_create(RenderContext *ctx, VkDeviceSize size,
+                                 u32 type, bool linear) {
+    GpuAllocator *allocator = &ctx->allocator;
+    MemoryBlock *block = NULL;
+    VkMemoryPropertyFlags props = ctx->mem_prop.memoryTypes[type].propertyFlags;
+
+    VkMemoryAllocateInfo alloc_info = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+        .allocationSize = size,
+        .memoryTypeIndex = type,
+    };
+
+    for (u32 idx = 0; idx < allocator->block_count; idx++) {
+        if (allocator->blocks[idx].mem == VK_NULL_HANDLE) {
+            block = &allocator->blocks[idx];
+            break;
+        }
+    }
+
+    if (!block) {
+        allocator->blocks = vrealloc(
+            allocator->blocks,
+            (allocator->block_count + 1) * sizeof(MemoryBlock)
+        );
+
+        block = &allocator->blocks[allocator->block_count++];
+    }
+
+    *block = (MemoryBlock) {
+        .size = size,
+        .type = type,
+        .linear = linear,
+    };
+
+    if (vkAllocateMemory(ctx->driver, &alloc_info, NULL, &block->mem)) {
+        error("failed to allocate a block of %lu bytes", (u64)size);
+        block->mem = VK_NULL_HANDLE;
+        return NULL;
+    }
+
+    if (props & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+        void *mapped;
+
+        if (vkMapMemory(ctx->driver, block->mem, 0, VK_WHOLE_SIZE, 0, &mapped)) {
+            error("failed to map block memory");
+            vkFreeMemory(ctx->driver, block->mem, NULL);
+            block->mem = VK_NULL_HANDLE;
+            return NULL;
+        }
+
+        block->mapped = mapped;
+    }
+
+    memory_range_insert(block, 0, (MemoryRange) { .offset = 0, .size = size });
+
+    trace("allocated block of %lu bytes, memory type %d", (u64)size, type);
+
+    return block;
+}
+
+void memory_block_destroy(RenderContext *ctx, MemoryBlock *block) {
+    // freeing the memory implicitly unmaps it
+    vkFreeMemory(ctx->driver, block->mem, NULL);
+    free(block->free);
+
+    block->mem = VK_NULL_HANDLE;
+    block->mapped = NULL;
+    block->free = NULL;
+    block->free_count = 0;
+    block->free_alloc_count = 0;
+}
+
+/* Sub-allocates memory for a resource with the requirements `reqs`.
+ *
+ * `linear` must be true for buffers and linearly tiled images, and false for
+ * optimally tiled images. */
+bool vk_memory_alloc(RenderContext *ctx, VkMemoryRequirements reqs,
+                     VkMemoryPropertyFlags flags, bool linear,
+                     GpuAllocation *alloc) {
+
+    GpuAllocator *allocator = &ctx->allocator;
+    MemoryBlock *block = NULL;
+    VkDeviceSize offset;
+    u32 type;
+
+    type = vk_find_memory_type(ctx, reqs, flags);
+
+    if (type == VK_MAX_MEMORY_TYPES)
+        return false;
+
+    for (u32 idx = 0; idx < allocator->block_count; idx++) {
+        MemoryBlock *candidate = &allocator->blocks[idx];
+
+        if (candidate->mem == VK_NULL_HANDLE ||
+            candidate->type != type ||
+            candidate->linear != linear)
+            continue;
+
+        if (memory_block_carve(candidate, reqs.size, reqs.alignment, &offset)) {
+            block = candidate;
+            break;
+        }
+    }
+
+    if (!block) {
+        VkDeviceSize size = reqs.size > MEMORY_BLOCK_SIZE
+            ? reqs.size
+            : MEMORY_BLOCK_SIZE;
+
+        if (!(block = memory_block_create(ctx, size, type, linear)))
+            return false;
+
+        // a fresh block always starts with a single range at offset 0
+        memory_block_carve(block, reqs.size, reqs.alignment, &offset);
+    }
+
+    alloc->mem = block->mem;
+    alloc->offset = offset;
+    alloc->size = reqs.size;
+    alloc->block = block - allocator->blocks;
+    alloc->mapped = block->mapped ? block->mapped + offset : NULL;
+
+    return true;
+}
+
+/* Returns an allocation to its block's free list, merging it with its
+ * neighbours. Blocks left empty are released back to the driver. */
+void vk_memory_free(RenderContext *ctx, GpuAllocation *alloc) {
+    MemoryBlock *block = &ctx->allocator.blocks[alloc->block];
+    MemoryRange range = { .offset = alloc->offset, .size = alloc->size };
+    u32 at = 0;
+
+    block->used -= alloc->size;
+    block->allocation_count--;
+
+    if (block->allocation_count == 0) {
+        memory_block_destroy(ctx, block);
+        return;
+    }
+
+    while (at < block->free_count && block->free[at].offset < range.offset)
+        at++;
+
+    memory_range_insert(block, at, range);
+
+    // merge with the next range
+    if (at + 1 < block->free_count &&
+        block->free[at].offset + block->free[at].size ==
+        block->free[at + 1].offset) {
+
+        block->free[at].size += block->free[at + 1].size;
+        memory_range_remove(block, at + 1);
+    }
+
+    // merge with the previous range
+    if (at > 0 &&
+        block->free[at - 1].offset + block->free[at - 1].size ==
+        block->free[at].offset) {
+
+        block->free[at - 1].size += block->free[at].size;
+        memory_range_remove(block, at);
+    }
+}
+
+/* Collects usage and fragmentation statistics over every block. */
+void vk_allocator_stats(RenderContext *ctx, GpuAllocatorStats *stats) {
+    GpuAllocator *allocator = &ctx->allocator;
+
+    *stats = (GpuAllocatorStats) {};
+
+    for (u32 idx = 0; idx < allocator->block_count; idx++) {
+        MemoryBlock *block = &allocator->blocks[idx];
+
+        if (block->mem == VK_NULL_HANDLE)
+            continue;
+
+        stats->block_count++;
+        stats->allocation_count += block->allocation_count;
+        stats->reserved += block->size;
+        stats->used += block->used;
+        stats->free_range_count += block->free_count;
+
+        for (u32 range = 0; range < block->free_count; range++) {
+            if (block->free[range].size > stats->largest_free_range)
+                stats->largest_free_range = block->free[range].size;
+        }
+    }
+}
+
+void vk_allocator_destroy(RenderContext *ctx) {
+    GpuAllocator *allocator = &ctx->allocator;
+
+    for (u32 idx = 0; idx < allocator->block_count; idx++) {
+        MemoryBlock *block = &allocator->blocks[idx];
+
+        if (block->mem == VK_NULL_HANDLE)
+            continue;
+
+        warn("%d allocations leaked in block %d", block->allocation_count, idx);
+        memory_block_destroy(ctx, block);
+    }
+
+    free(allocator->blocks);
+    allocator->blocks = NULL;
+    allocator->block_count = 0;
+}
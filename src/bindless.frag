@@ -0,0 +1,29 @@
+#version 450
+#extension GL_EXT_nonuniform_qualifier : require
+
+layout(location = 0) in vec2 uv;
+layout(location = 0) out vec4 color;
+
+layout(binding = 0) uniform sampler2D textures[];
+
+/* Offset by the `TileGrid` used by the vertex stage */
+layout(push_constant) uniform Draw {
+    layout(offset = 8) uint texture_index;
+} draw;
+
+/* Pixel filtering algorithm */
+vec2 filterer( vec2 uv, ivec2 size ) {
+    vec2 pixel = uv * size;
+
+    vec2 seam = floor(pixel + 0.5);
+    pixel = seam + clamp((pixel - seam) / fwidth(pixel), -0.5, 0.5);
+
+    return pixel / size;
+}
+
+void main() {
+    uint idx = nonuniformEXT(draw.texture_index);
+    ivec2 texture_size = textureSize(textures[idx], 0);
+
+    color = texture(textures[idx], filterer(uv, texture_size));
+}
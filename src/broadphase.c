@@ -0,0 +1,118 @@
+#include "utils.h"
+#include "render.h"
+
+#include <stdlib.h>
+
+int broadphase_entry_cmp(const void *lhs, const void *rhs) {
+    const BroadphaseEntry *a = lhs, *b = rhs;
+
+    return (a->min > b->min) - (a->min < b->min);
+}
+
+/* Refreshes every interval from `bounds` and restores the ordering.
+ *
+ * When the number of objects changed the entries are rebuilt and sorted
+ * from scratch, otherwise they're insertion sorted which is close to linear
+ * for entries that were already mostly in order. */
+void broadphase_sort(Broadphase *phase, const ObjectBounds *bounds, u32 count) {
+    BroadphaseEntry *entries;
+
+    if (count > phase->entry_alloc_count) {
+        phase->entry_alloc_count = count;
+        phase->entries = vrealloc(
+            phase->entries,
+            phase->entry_alloc_count * sizeof(BroadphaseEntry)
+        );
+    }
+
+    entries = phase->entries;
+
+    if (count != phase->entry_count) {
+        for (u32 idx = 0; idx < count; idx++) {
+            entries[idx].min = bounds[idx].min[0];
+            entries[idx].max = bounds[idx].max[0];
+            entries[idx].index = idx;
+        }
+
+        phase->entry_count = count;
+        qsort(entries, count, sizeof(BroadphaseEntry), broadphase_entry_cmp);
+        return;
+    }
+
+    for (u32 idx = 0; idx < count; idx++) {
+        entries[idx].min = bounds[entries[idx].index].min[0];
+        entries[idx].max = bounds[entries[idx].index].max[0];
+    }
+
+    for (u32 idx = 1; idx < count; idx++) {
+        BroadphaseEntry entry = entries[idx];
+        u32 at = idx;
+
+        while (at > 0 && entries[at - 1].min > entry.min) {
+            entries[at] = entries[at - 1];
+            at--;
+        }
+
+        entries[at] = entry;
+    }
+}
+
+void broadphase_pair_push(Broadphase *phase, u32 a, u32 b) {
+    if (phase->pair_count == phase->pair_alloc_count) {
+        phase->pair_alloc_count = phase->pair_alloc_count * 2 + 64;
+        phase->pairs = vrealloc(
+            phase->pairs,
+            phase->pair_alloc_count * sizeof(CollisionPair)
+        );
+    }
+
+    phase->pairs[phase->pair_count++] = (CollisionPair) {
+        .a = a < b ? a : b,
+        .b = a < b ? b : a,
+    };
+}
+
+/* Finds every pair of objects whose bounding boxes overlap, leaving them in
+ * `phase->pairs` for the narrowphase.
+ *
+ * `bounds` are the dense bounds of `ObjectStore`, pairs refer to objects by
+ * their dense index. Every box is only compared against the boxes whose
+ * x-interval starts before it ends. */
+void broadphase_update(Broadphase *phase, const ObjectBounds *bounds, u32 count) {
+    BroadphaseEntry *entries;
+
+    broadphase_sort(phase, bounds, count);
+
+    entries = phase->entries;
+    phase->pair_count = 0;
+
+    for (u32 idx = 0; idx < count; idx++) {
+        const ObjectBounds *box = &bounds[entries[idx].index];
+
+        for (u32 next = idx + 1; next < count; next++) {
+            const ObjectBounds *other;
+
+            if (entries[next].min > entries[idx].max)
+                break;
+
+            other = &bounds[entries[next].index];
+
+            if (other->min[1] > box->max[1] || other->max[1] < box->min[1])
+                continue;
+
+            broadphase_pair_push(phase, entries[idx].index, entries[next].index);
+        }
+    }
+}
+
+void broadphase_destroy(Broadphase *phase) {
+    free(phase->entries);
+    free(phase->pairs);
+
+    phase->entries = NULL;
+    phase->entry_count = 0;
+    phase->entry_alloc_count = 0;
+    phase->pairs = NULL;
+    phase->pair_count = 0;
+    phase->pair_alloc_count = 0;
+}
@@ -0,0 +1,151 @@
+#include "utils.h"
+#include "render.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/* Tolerance for boxes resting exactly on a cell's edge, in cells */
+#define COLLISION_EPSILON 1e-4
+
+/* Largest integer not greater than `val`, without pulling in libm. */
+i32 cell_floor(f32 val) {
+    i32 trunc = (i32)val;
+    return trunc - ((f32)trunc > val);
+}
+
+/* Smallest integer not less than `val`. */
+i32 cell_ceil(f32 val) {
+    i32 trunc = (i32)val;
+    return trunc + ((f32)trunc < val);
+}
+
+/* Grows the grid to at least `width` by `height` cells, new cells are
+ * empty. */
+void collision_grid_reserve(CollisionGrid *grid, u32 width, u32 height) {
+    u8 *cells;
+
+    if (width <= grid->size[0] && height <= grid->size[1])
+        return;
+
+    if (width < grid->size[0])
+        width = grid->size[0];
+
+    if (height < grid->size[1])
+        height = grid->size[1];
+
+    cells = vcalloc(width * height);
+
+    for (u32 y = 0; y < grid->size[1]; y++)
+        memcpy(&cells[y * width], &grid->cells[y * grid->size[0]], grid->size[0]);
+
+    free(grid->cells);
+    grid->cells = cells;
+    grid->size[0] = width;
+    grid->size[1] = height;
+}
+
+/* Returns whether a cell is solid, everything outside of the grid is. */
+bool collision_grid_solid(CollisionGrid *grid, i32 x, i32 y) {
+    if (x < 0 || y < 0 || x >= (i32)grid->size[0] || y >= (i32)grid->size[1])
+        return true;
+
+    return grid->cells[y * grid->size[0] + x];
+}
+
+/* Moves a box along a single axis in cell units, returning how far it gets
+ * before touching a solid cell.
+ *
+ * `lo` and `hi` are the box's extent along the moving axis, `across_lo`
+ * and `across_hi` along the other one. Only the cells the leading edge
+ * enters are visited. */
+f32 collision_sweep_axis(CollisionGrid *grid, u32 axis, f32 lo, f32 hi,
+                         f32 across_lo, f32 across_hi, f32 delta) {
+
+    i32 first = cell_floor(across_lo + COLLISION_EPSILON);
+    i32 last = cell_ceil(across_hi - COLLISION_EPSILON) - 1;
+
+    if (delta > 0.0) {
+        i32 from = cell_ceil(hi - COLLISION_EPSILON);
+        i32 to = cell_ceil(hi + delta) - 1;
+
+        for (i32 cell = from; cell <= to; cell++) {
+            for (i32 other = first; other <= last; other++) {
+                bool solid = axis == 0
+                    ? collision_grid_solid(grid, cell, other)
+                    : collision_grid_solid(grid, other, cell);
+
+                // stop flush against the cell
+                if (solid)
+                    return (f32)cell - hi > 0.0 ? (f32)cell - hi : 0.0;
+            }
+        }
+    } else if (delta < 0.0) {
+        i32 from = cell_floor(lo + COLLISION_EPSILON) - 1;
+        i32 to = cell_floor(lo + delta);
+
+        for (i32 cell = from; cell >= to; cell--) {
+            for (i32 other = first; other <= last; other++) {
+                bool solid = axis == 0
+                    ? collision_grid_solid(grid, cell, other)
+                    : collision_grid_solid(grid, other, cell);
+
+                if (solid)
+                    return (f32)(cell + 1) - lo < 0.0 ? (f32)(cell + 1) - lo : 0.0;
+            }
+        }
+    }
+
+    return delta;
+}
+
+/* Sweeps `box` by `delta` through the grid, shortening `delta` so that the
+ * box ends up touching rather than overlapping any solid cell.
+ *
+ * The x-axis is resolved before the y-axis so movers slide along walls.
+ * Costs a lookup per cell crossed by the box's leading edges, regardless of
+ * the size of the level. */
+void collision_sweep(CollisionGrid *grid, const ObjectBounds *box, f32 delta[2]) {
+    f32 lo[2], hi[2];
+
+    if (grid->cells == NULL)
+        return;
+
+    // convert the box into cell units
+    for (u32 axis = 0; axis < 2; axis++) {
+        lo[axis] = (box->min[axis] - grid->origin[axis]) / grid->cell_size[axis];
+        hi[axis] = (box->max[axis] - grid->origin[axis]) / grid->cell_size[axis];
+    }
+
+    delta[0] = collision_sweep_axis(
+        grid,
+        0,
+        lo[0],
+        hi[0],
+        lo[1],
+        hi[1],
+        delta[0] / grid->cell_size[0]
+    );
+
+    lo[0] += delta[0];
+    hi[0] += delta[0];
+
+    delta[1] = collision_sweep_axis(
+        grid,
+        1,
+        lo[1],
+        hi[1],
+        lo[0],
+        hi[0],
+        delta[1] / grid->cell_size[1]
+    );
+
+    delta[0] *= grid->cell_size[0];
+    delta[1] *= grid->cell_size[1];
+}
+
+void collision_grid_destroy(CollisionGrid *grid) {
+    free(grid->cells);
+    grid->cells = NULL;
+    grid->size[0] = 0;
+    grid->size[1] = 0;
+}
@@ -0,0 +1,172 @@
+#include "utils.h"
+#include "render.h"
+
+#include <string.h>
+
+/* Returns whether `count` elements of `size` bytes starting at `offset`
+ * are within the level and aligned.
+ *
+ * The space left is divided instead of multiplying `count` so a corrupt
+ * count can't overflow. */
+bool level_section_fits(Level *level, u64 offset, u64 count, u64 size) {
+    return offset % 8 == 0 &&
+           offset <= level->file.size &&
+           count <= (level->file.size - offset) / size;
+}
+
+/* Checks that the header matches this build and that every section and
+ * chunk lies within the file.
+ *
+ * Tiles themselves are left alone so they're only paged in once streamed,
+ * they're checked by `level_chunks_receive` as they arrive. */
+bool level_validate(Level *level, const char *path) {
+    const LevelHeader *header = level->header;
+    u64 cells, sprites, chunks;
+
+    if (level->file.size < sizeof(LevelHeader) || header->magic != LEVEL_MAGIC) {
+        error("'%s' isn't a compiled level", path);
+        return false;
+    }
+
+    if (header->version != LEVEL_VERSION) {
+        error(
+            "level '%s' is version %d instead of %d, recompile it",
+            path,
+            header->version,
+            LEVEL_VERSION
+        );
+        return false;
+    }
+
+    if (header->chunk_size != CHUNK_SIZE) {
+        error(
+            "level '%s' has chunks of %d tiles instead of %d, recompile it",
+            path,
+            header->chunk_size,
+            CHUNK_SIZE
+        );
+        return false;
+    }
+
+    if (header->tile_size[0] == 0 || header->tile_size[1] == 0) {
+        error("level '%s' has a tileset without a sprite size", path);
+        return false;
+    }
+
+    for (u32 axis = 0; axis < 2; axis++) {
+        if (header->chunks[axis] != (header->size[axis] + CHUNK_SIZE - 1) / CHUNK_SIZE) {
+            error("level '%s' has the wrong number of chunks", path);
+            return false;
+        }
+    }
+
+    cells = (u64)header->size[0] * header->size[1];
+    sprites = (u64)header->atlas_size[0] * header->atlas_size[1];
+    chunks = (u64)header->chunks[0] * header->chunks[1];
+
+    // there can't be more chunks than bytes in the file, which bounds the
+    // number of layers before multiplying by it
+    if (chunks != 0 && header->layer_count > level->file.size / chunks) {
+        error("level '%s' is truncated", path);
+        return false;
+    }
+
+    chunks *= header->layer_count;
+
+    if (!level_section_fits(level, header->flags_offset, cells, 1) ||
+        !level_section_fits(level, header->uvs_offset, sprites, sizeof(LevelUv)) ||
+        !level_section_fits(level, header->chunks_offset, chunks, sizeof(LevelChunk))) {
+        error("level '%s' is truncated", path);
+        return false;
+    }
+
+    if (header->tileset_offset >= level->file.size ||
+        !memchr(
+            level->file.data + header->tileset_offset,
+            '\0',
+            level->file.size - header->tileset_offset
+        )) {
+        error("level '%s' has no tileset", path);
+        return false;
+    }
+
+    level->tileset = (const char *)(level->file.data + header->tileset_offset);
+    level->flags = level->file.data + header->flags_offset;
+    level->uvs = (const LevelUv *)(level->file.data + header->uvs_offset);
+    level->chunks = (const LevelChunk *)(level->file.data + header->chunks_offset);
+
+    for (u64 idx = 0; idx < chunks; idx++) {
+        const LevelChunk *chunk = &level->chunks[idx];
+
+        if (!level_section_fits(level, chunk->offset, chunk->tile_count, sizeof(TileInstance))) {
+            error("level '%s' has a chunk outside of the file", path);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/* Maps a level compiled by `tools/levelc.c` into memory and adds its
+ * layers, which are streamed in chunks by `level_stream`.
+ *
+ * Nothing is parsed, the tiles of a chunk are uploaded straight from the
+ * mapping once the camera gets close to them. The solid cells are copied
+ * into the collision grid up front. The tileset is loaded afterwards with
+ * `level_atlas_load`. */
+bool level_load(RenderContext *ctx, const char *path) {
+    Level *level = &ctx->level;
+    const LevelHeader *header;
+    CollisionGrid *grid = &ctx->collision;
+
+    if (!file_map(path, &level->file)) {
+        error("failed to read level: '%s'", path);
+        return false;
+    }
+
+    level->header = (const LevelHeader *)level->file.data;
+
+    if (!level_validate(level, path)) {
+        level_unload(ctx);
+        return false;
+    }
+
+    header = level->header;
+    ctx->layers = vmalloc(header->layer_count * sizeof(TileLayer));
+    ctx->layer_count = header->layer_count;
+
+    for (u32 idx = 0; idx < header->layer_count; idx++) {
+        ctx->layers[idx] = (TileLayer) {
+            .level_chunks = &level->chunks[idx * header->chunks[0] * header->chunks[1]],
+            .size = { header->size[0], header->size[1] },
+        };
+    }
+
+    // the level spans every cell, even ones of chunks that aren't loaded
+    collision_grid_reserve(grid, header->size[0], header->size[1]);
+
+    for (u32 y = 0; y < header->size[1]; y++) {
+        for (u32 x = 0; x < header->size[0]; x++) {
+            u8 flags = level->flags[y * header->size[0] + x];
+            grid->cells[y * grid->size[0] + x] = (flags & TILE_SOLID) != 0;
+        }
+    }
+
+    trace(
+        "level '%s' is %d by %d tiles in %d layers%s",
+        path,
+        header->size[0],
+        header->size[1],
+        header->layer_count,
+        level->file.mapped ? "" : ", read without mapping it"
+    );
+
+    return true;
+}
+
+/* Releases the level loaded by `level_load`, the layers referring to it
+ * must've been destroyed with `level_layers_destroy` beforehand. */
+void level_unload(RenderContext *ctx) {
+    file_unmap(&ctx->level.file);
+    ctx->level = (Level) {};
+}
@@ -5,13 +5,6 @@
 #include <stdio.h>
 #include <stdlib.h>
 
-static f32 BG_COORDS[4][2] = {
-    { -1.0, -1.0 },
-    {  1.0, -1.0 },
-    {  1.0,  1.0 },
-    { -1.0,  1.0 }
-};
-
 static f32 FULLSCREEN_REGION[2][2] = {
     { 0.217578, 0.266250 },
     { 0.780078, 0.365625 }
@@ -22,11 +15,6 @@ static f32 QUIT_REGION[2][2] = {
     { 0.599609, 0.691875 }
 };
 
-static f32 ROOM_REGION[2][2] = {
-    { -1.0 - 1.0/32.0, -1.0 - 2.0/18.0 },
-    {  1.0 + 1.0/32.0,  1.0 + 1.0/32.0 }
-};
-
 static const u8 *KEYBOARD;
 
 /* Returns whether coords are within a square region.
@@ -64,7 +52,7 @@ void handler_mouse(RenderContext *ctx, Game *state, i32 x, i32 y) {
 }
 
 void handler_keyboard(RenderContext *ctx, Game *game) {
-    f64 speed = 0.00075;
+    f64 speed = 0.108;
     f64 vertical = (f32)(KEYBOARD[SDL_SCANCODE_S] - KEYBOARD[SDL_SCANCODE_W]);
     f64 horizontal = (f32)(KEYBOARD[SDL_SCANCODE_D] - KEYBOARD[SDL_SCANCODE_A]);
 
@@ -73,8 +61,25 @@ void handler_keyboard(RenderContext *ctx, Game *game) {
         speed *= 0.707;
     }
 
-    game->dy += (f32)(vertical * 16.0 * speed);
-    game->dx += (f32)(horizontal * 9.0 * speed);
+    game->dy += (f32)(vertical * speed);
+    game->dx += (f32)(horizontal * speed);
+}
+
+/* Corners of the part of the world that's on screen, for overlays that
+ * cover all of it. */
+void camera_corners(RenderContext *ctx, f32 corners[4][2]) {
+    Camera *camera = &ctx->camera;
+    f32 right = camera->pos[0] + 2.0 / camera->scale[0];
+    f32 bottom = camera->pos[1] + 2.0 / camera->scale[1];
+
+    corners[0][0] = camera->pos[0];
+    corners[0][1] = camera->pos[1];
+    corners[1][0] = right;
+    corners[1][1] = camera->pos[1];
+    corners[2][0] = right;
+    corners[2][1] = bottom;
+    corners[3][0] = camera->pos[0];
+    corners[3][1] = bottom;
 }
 
 void handler_event(RenderContext *ctx, Game *game) {
@@ -92,105 +97,176 @@ void handler_event(RenderContext *ctx, Game *game) {
 
             if (game->menu_open) {
                 object_find_destroy(ctx, HASH("./assets/escape_menu.bmp"));
+                game->menu_open = false;
             } else {
-                object_create(ctx, BG_COORDS, "./assets/escape_menu.bmp");
+                f32 corners[4][2];
+
+                camera_corners(ctx, corners);
+                game->menu_open = object_create(
+                    ctx,
+                    corners,
+                    "./assets/escape_menu.bmp",
+                    NULL
+                );
             }
-
-            game->menu_open = !game->menu_open;
         }
     }
 }
 
-/* Detects whether an object will collide with the environment and returns
- * whether this collision will occur */
-void resolve_collisions(Object *obj, Game *game) {
-    for (u32 idx = 0; idx < obj->vertices_count; idx++) {
-        f32 pos[2];
+/* Shortens the movement of an object so that it stops against solid tiles
+ * of the level instead of walking through them */
+void resolve_collisions(RenderContext *ctx, ObjectBounds *bounds, Game *game) {
+    f32 delta[2] = { game->dx, game->dy };
 
-        pos[0] = obj->vertices[idx].pos[0] + game->dx;
-        pos[1] = obj->vertices[idx].pos[1] + game->dy;
-
-        // check if x coordinate would collide
-        if (pos[0] < ROOM_REGION[0][0] || pos[0] > ROOM_REGION[1][0]) {
-            game->dx = 0.0;
-        }
+    collision_sweep(&ctx->collision, bounds, delta);
 
-        // check if y coordinate would collide
-        if (pos[1] < ROOM_REGION[0][1] || pos[1] > ROOM_REGION[1][1]) {
-            game->dy = 0.0;
-        }
-    }
+    game->dx = delta[0];
+    game->dy = delta[1];
 }
 
-void render(RenderContext *ctx, Game *game) {
-    Object *player = object_find(ctx, HASH("./assets/guy.bmp"));
+/* Advances the game by a single `TICK_TIME` step. */
+void simulate(RenderContext *ctx, Game *game) {
+    u32 player = object_get(ctx, game->player);
 
-    handler_keyboard(ctx, game);
+    objects_tick(ctx);
 
-    if (game->dx != 0.0 || game->dy != 0.0) {
-        resolve_collisions(player, game);
-        object_transform(player, game->dx, game->dy);
-        vk_vertices_update(ctx, player, OBJECT_PLAYER);
+    // the menu is placed in the world where it was opened, so the player
+    // and with it the camera stay put until it's closed
+    if (!game->menu_open)
+        handler_keyboard(ctx, game);
 
-        game->dx = 0.0;
-        game->dy = 0.0;
+    if (player != OBJECT_NONE && (game->dx != 0.0 || game->dy != 0.0)) {
+        resolve_collisions(ctx, &ctx->objects.bounds[player], game);
+        object_transform(ctx, player, game->dx, game->dy);
     }
+
+    game->dx = 0.0;
+    game->dy = 0.0;
 }
 
-#define FRAME_TIME 1000000000 / 75
+/* Rate at which the game is simulated, independent of the frame rate */
+#define TICK_RATE 75
+#define TICK_TIME (1.0 / TICK_RATE)
+
+/* Longest frame the simulation catches up on, anything beyond it slows the
+ * game down rather than stalling on simulation ticks */
+#define MAX_CATCH_UP 0.25
+
+/* Frame rate used when neither `--fps` nor the display's refresh rate is
+ * known */
+#define DEFAULT_FPS 75
+
+/* Keeps the player in the middle of the screen where it's drawn. */
+void camera_follow(RenderContext *ctx, Game *game) {
+    u32 player = object_get(ctx, game->player);
+    ObjectBounds bounds;
+
+    if (player == OBJECT_NONE)
+        return;
+
+    object_drawn_bounds(ctx, player, &bounds);
+    camera_center(
+        ctx,
+        (bounds.min[0] + bounds.max[0]) / 2.0,
+        (bounds.min[1] + bounds.max[1]) / 2.0
+    );
+}
 
 void event_loop(RenderContext *ctx) {
     Game game = {};
+    FramePacer pacer;
+    u64 last_tick = now_ns();
+    f64 accumulator = 0.0;
 
-    for (;;) {
-        struct timespec start;
-        struct timespec end;
-        struct timespec diff;
+    game.player = object_find(ctx, HASH("./assets/guy.bmp"));
+    pacer_init(&pacer, ctx->target_fps);
 
-        now(&start);
+    for (;;) {
+        u64 time;
 
         handler_event(ctx, &game);
-        render(ctx, &game);
-        vk_engine_render(ctx);
 
-        if (game.quit_game)
-            break;
+        time = now_ns();
+        accumulator += (f64)(time - last_tick) * 1.0e-9;
+        last_tick = time;
 
-        now(&end);
+        if (accumulator > MAX_CATCH_UP)
+            accumulator = MAX_CATCH_UP;
 
-        // calculate the difference between `start` and `end`
-        if ((end.tv_nsec - start.tv_nsec) < 0) {
-            diff.tv_sec = end.tv_sec - start.tv_sec - 1;
-            diff.tv_nsec = 1000000000 + end.tv_nsec - start.tv_nsec;
-        } else {
-            diff.tv_sec = end.tv_sec - start.tv_sec;
-            diff.tv_nsec = end.tv_nsec - start.tv_nsec;
+        // run as many fixed steps as the elapsed time covers
+        while (accumulator >= TICK_TIME) {
+            simulate(ctx, &game);
+            accumulator -= TICK_TIME;
         }
 
-        diff.tv_nsec = FRAME_TIME - diff.tv_nsec;
+        // draw objects between the last two ticks by the leftover time
+        objects_interpolate(ctx, (f32)(accumulator / TICK_TIME));
+        camera_follow(ctx, &game);
+        level_stream(ctx);
+        vk_engine_render(ctx);
 
-        // don't sleep if more than one second has elapsed or if
-        // more than 1/60's of a second has elapsed
-        if (diff.tv_sec != 0 || diff.tv_nsec > FRAME_TIME)
-            continue;
+        if (game.quit_game)
+            break;
 
-        nanosleep(&diff, NULL);
+        pacer_wait(&pacer);
     }
 }
 
+/* Maps a `--present-mode` argument onto its present mode, returns false for
+ * names that aren't recognised. */
+bool parse_present_mode(const char *name, VkPresentModeKHR *present_mode) {
+    if (strcmp(name, "fifo") == 0)
+        *present_mode = VK_PRESENT_MODE_FIFO_KHR;
+    else if (strcmp(name, "fifo-relaxed") == 0)
+        *present_mode = VK_PRESENT_MODE_FIFO_RELAXED_KHR;
+    else if (strcmp(name, "mailbox") == 0)
+        *present_mode = VK_PRESENT_MODE_MAILBOX_KHR;
+    else if (strcmp(name, "immediate") == 0)
+        *present_mode = VK_PRESENT_MODE_IMMEDIATE_KHR;
+    else
+        return false;
+
+    return true;
+}
+
 i32 main(i32 argc, const char *argv[]) {
-    RenderContext ctx;
+    RenderContext ctx = {};
     struct timespec time;
+    bool fps_set = false;
+
+    ctx.instancing = true;
+    ctx.present_mode = VK_PRESENT_MODE_MAILBOX_KHR;
 
-    if (argc > 1) {
-        if (strcmp(argv[1], "--error") == 0) {
+    for (i32 idx = 1; idx < argc; idx++) {
+        if (strcmp(argv[idx], "--error") == 0) {
             set_log_level(LOG_ERROR);
-        } else if (strcmp(argv[1], "--warn") == 0) {
+        } else if (strcmp(argv[idx], "--warn") == 0) {
             set_log_level(LOG_WARN);
-        } else if (strcmp(argv[1], "--trace") == 0) {
+        } else if (strcmp(argv[idx], "--trace") == 0) {
             set_log_level(LOG_TRACE);
-        } else if (strcmp(argv[1], "--info") == 0) {
+        } else if (strcmp(argv[idx], "--info") == 0) {
             set_log_level(LOG_INFO);
+        } else if (strcmp(argv[idx], "--no-instancing") == 0) {
+            // expand tiles into quads on the CPU instead
+            ctx.instancing = false;
+        } else if (strcmp(argv[idx], "--fps") == 0 && idx + 1 < argc) {
+            // 0 leaves frames uncapped
+            ctx.target_fps = strtoul(argv[++idx], NULL, 10);
+            fps_set = true;
+        } else if (strcmp(argv[idx], "--bindless") == 0) {
+            // index textures from a single descriptor array if supported
+            ctx.bindless = true;
+        } else if (strcmp(argv[idx], "--present-mode") == 0 && idx + 1 < argc) {
+            // fifo waits for vblank, mailbox replaces queued frames and
+            // immediate tears
+            if (!parse_present_mode(argv[++idx], &ctx.present_mode))
+                warn("unknown present mode '%s', using mailbox", argv[idx]);
+        } else if (strcmp(argv[idx], "--swapchain-images") == 0 && idx + 1 < argc) {
+            // 0 picks one more than the surface's minimum
+            ctx.swapchain_images = strtoul(argv[++idx], NULL, 10);
+        } else if (strcmp(argv[idx], "--frames-in-flight") == 0 && idx + 1 < argc) {
+            // fewer frames lower latency, more let the CPU run further ahead
+            ctx.frames_in_flight = strtoul(argv[++idx], NULL, 10);
         }
     }
 
@@ -199,6 +275,21 @@ i32 main(i32 argc, const char *argv[]) {
     sdl_renderer_create(&ctx);
     KEYBOARD = SDL_GetKeyboardState(NULL);
 
+    // pace frames to the display unless told otherwise
+    if (!fps_set) {
+        SDL_DisplayMode mode;
+
+        if (SDL_GetWindowDisplayMode(ctx.window, &mode) == 0 && mode.refresh_rate > 0)
+            ctx.target_fps = mode.refresh_rate;
+        else
+            ctx.target_fps = DEFAULT_FPS;
+    }
+
+    if (ctx.target_fps)
+        info("pacing frames to %d fps", ctx.target_fps);
+    else
+        info("frames are uncapped");
+
     vk_engine_create(&ctx);
 
     info("%lf seconds elapsed to initialize vulkan", time_elapsed(&time));
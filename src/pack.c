@@ -0,0 +1,128 @@
+#include "utils.h"
+#include "render.h"
+
+#include <string.h>
+
+/* Returns whether `size` bytes starting at `offset` are within the pack. */
+bool asset_pack_fits(AssetPack *pack, u64 offset, u64 size) {
+    return offset <= pack->file.size && size <= pack->file.size - offset;
+}
+
+/* Checks that the header matches this build and that every image and its
+ * path lies within the file. */
+bool asset_pack_validate(AssetPack *pack, const char *path) {
+    const PackHeader *header = pack->header;
+    u32 used = 0;
+
+    if (pack->file.size < sizeof(PackHeader) || header->magic != PACK_MAGIC) {
+        error("'%s' isn't an asset pack", path);
+        return false;
+    }
+
+    if (header->version != PACK_VERSION) {
+        error(
+            "asset pack '%s' is version %d instead of %d, rebuild it",
+            path,
+            header->version,
+            PACK_VERSION
+        );
+        return false;
+    }
+
+    if (header->slot_count == 0 ||
+        (header->slot_count & (header->slot_count - 1)) != 0 ||
+        header->directory_offset % 8 != 0 ||
+        !asset_pack_fits(
+            pack,
+            header->directory_offset,
+            (u64)header->slot_count * sizeof(PackEntry)
+        )) {
+        error("asset pack '%s' has a broken directory", path);
+        return false;
+    }
+
+    pack->slots = (const PackEntry *)(pack->file.data + header->directory_offset);
+
+    for (u32 idx = 0; idx < header->slot_count; idx++) {
+        const PackEntry *entry = &pack->slots[idx];
+        u64 pixels_size = (u64)entry->size[0] * entry->size[1] * 4;
+
+        if (entry->path_length == 0)
+            continue;
+
+        used++;
+
+        if (!asset_pack_fits(pack, entry->path_offset, (u64)entry->path_length + 1) ||
+            pack->file.data[entry->path_offset + entry->path_length] != '\0' ||
+            entry->pixels_offset % PACK_ALIGNMENT != 0 ||
+            !asset_pack_fits(pack, entry->pixels_offset, pixels_size)) {
+            error("asset pack '%s' has an image outside of the file", path);
+            return false;
+        }
+    }
+
+    // lookups stop at the first empty slot
+    if (used == header->slot_count) {
+        error("asset pack '%s' has a full directory", path);
+        return false;
+    }
+
+    return true;
+}
+
+/* Maps an asset pack built by `tools/assetpack.c` into memory, images found
+ * in it are no longer opened and converted one by one. */
+bool asset_pack_load(RenderContext *ctx, const char *path) {
+    AssetPack *pack = &ctx->pack;
+
+    if (!file_map(path, &pack->file))
+        return false;
+
+    pack->header = (const PackHeader *)pack->file.data;
+
+    if (!asset_pack_validate(pack, path)) {
+        asset_pack_unload(ctx);
+        return false;
+    }
+
+    trace("asset pack '%s' holds %d images", path, pack->header->image_count);
+
+    return true;
+}
+
+/* Looks up an image by the path it was packed from, NULL when the pack
+ * doesn't hold it or no pack was loaded. */
+const PackEntry *asset_pack_find(RenderContext *ctx, const char *path) {
+    AssetPack *pack = &ctx->pack;
+    u32 key, mask;
+
+    if (!pack->header)
+        return NULL;
+
+    key = hash(path);
+    mask = pack->header->slot_count - 1;
+
+    // linear probing, the table always has empty slots
+    for (u32 idx = key & mask;; idx = (idx + 1) & mask) {
+        const PackEntry *entry = &pack->slots[idx];
+        const char *entry_path;
+
+        if (entry->path_length == 0)
+            return NULL;
+
+        if (entry->key != key)
+            continue;
+
+        entry_path = (const char *)(pack->file.data + entry->path_offset);
+
+        if (strcmp(entry_path, path) == 0)
+            return entry;
+    }
+}
+
+/* Releases the pack, textures created from it keep their own copy on the
+ * GPU. */
+void asset_pack_unload(RenderContext *ctx) {
+    file_unmap(&ctx->pack.file);
+    ctx->pack = (AssetPack) {};
+}
@@ -36,9 +36,26 @@ void sdl_renderer_destroy(RenderContext *ctx) {
     info("SDL2 destroyed");
 }
 
-SDL_Surface *sdl_load_image(const char *path) {
+/* Loads an image in the format of `VK_FORMAT_B8G8R8A8_SRGB`.
+ *
+ * Images held by the asset pack are wrapped without copying or converting
+ * their pixels, so the surface is only valid while the pack is loaded.
+ * Anything else is read from disk and converted. */
+SDL_Surface *sdl_load_image(RenderContext *ctx, const char *path) {
+    const PackEntry *entry = asset_pack_find(ctx, path);
     SDL_Surface *img, *conv_img;
 
+    if (entry) {
+        return SDL_CreateRGBSurfaceWithFormatFrom(
+            (void *)(ctx->pack.file.data + entry->pixels_offset),
+            entry->size[0],
+            entry->size[1],
+            32,
+            entry->size[0] * 4,
+            SDL_PIXELFORMAT_BGRA32
+        );
+    }
+
     if (!(img = SDL_LoadBMP(path))) {
         return NULL;
     }
@@ -60,124 +77,426 @@ SDL_Surface *sdl_load_image(const char *path) {
     return conv_img;
 }
 
-SDL_Surface *tileset_sprite_load(RenderContext *ctx,
-                                 SDL_Surface *tileset,
-                                 SDL_Rect *sprite_region) {
+/* Key identifying a region of an image, hashed from both of them. */
+u32 texture_key(const char *path, const SDL_Rect *region) {
+    return hash(path) * 65599u + hash_bytes(region, sizeof(SDL_Rect));
+}
 
-    SDL_Surface *dst = SDL_CreateRGBSurfaceWithFormat(
+/* Copies `region` out of `img` into a new surface of the same format. */
+SDL_Surface *sdl_surface_crop(SDL_Surface *img, const SDL_Rect *region) {
+    SDL_Surface *crop = SDL_CreateRGBSurfaceWithFormat(
         0,
-        sprite_region->w,
-        sprite_region->h,
-        16,
+        region->w,
+        region->h,
+        32,
         SDL_PIXELFORMAT_BGRA32
     );
 
-    if (SDL_BlitSurface(tileset, sprite_region, dst, NULL) == -1) {
-        error("failed to copy tileset surface region");
+    if (!crop)
+        return NULL;
+
+    if (SDL_BlitSurface(img, region, crop, NULL)) {
+        SDL_FreeSurface(crop);
         return NULL;
     }
 
-    return dst;
+    return crop;
 }
 
-Object *object_alloc(RenderContext *ctx) {
-    /* Initially allocate 32 * 18 * 2 + 2 objects.
-     *
-     * Enough for a two room's, a player and an exit menu. */
+/* Returns the slot holding the texture loaded from `region` of `path` or
+ * the empty slot it would be inserted into. */
+CachedTexture **texture_cache_find(TextureCache *cache, const char *path,
+                                   const SDL_Rect *region, u32 key) {
+
+    u32 mask = cache->capacity - 1;
 
-    if (ctx->object_alloc_count == 0) {
-        ctx->object_alloc_count = 32 * 18 * 2 + 2;
-        ctx->object_count = 1;
+    for (u32 idx = key & mask;; idx = (idx + 1) & mask) {
+        CachedTexture *entry = cache->entries[idx];
 
-        ctx->objects = vmalloc(ctx->object_alloc_count * sizeof(Object));
+        if (!entry)
+            return &cache->entries[idx];
 
-        return &ctx->objects[0];
+        if (entry->key != key || strcmp(entry->path, path) != 0)
+            continue;
+
+        if (memcmp(&entry->region, region, sizeof(SDL_Rect)) == 0)
+            return &cache->entries[idx];
     }
+}
 
-    ctx->object_count++;
+/* Doubles the number of slots, keeping the table at most 3/4 full. */
+void texture_cache_grow(TextureCache *cache) {
+    CachedTexture **entries = cache->entries;
+    u32 capacity = cache->capacity;
 
-    // if memory for a new object exists, use it
-    if (ctx->object_count < ctx->object_alloc_count)
-        return &ctx->objects[ctx->object_count - 1];
+    cache->capacity = capacity ? capacity * 2 : 16;
+    cache->entries = vcalloc(cache->capacity * sizeof(CachedTexture *));
 
-    // if there isn't enough space, allocate twice as much and copy over objects
-    ctx->object_alloc_count *= 2;
-    ctx->objects = vrealloc(ctx->objects, ctx->object_alloc_count);
+    for (u32 idx = 0; idx < capacity; idx++) {
+        CachedTexture *entry = entries[idx];
 
-    return &ctx->objects[ctx->object_count - 1];
+        if (entry)
+            *texture_cache_find(cache, entry->path, &entry->region, entry->key) = entry;
+    }
+
+    free(entries);
 }
 
-/* Loads a sprite from a level map into an object */
-bool object_from_tile(RenderContext *ctx,
-                      u32 x, u32 y,
-                      SDL_Surface *tile,
-                      u32 ident) {
+/* Creates a texture from a region of an image, or reuses the texture if
+ * the same region of the same image was already loaded.
+ *
+ * A NULL `region` uploads the whole image. Every acquired texture has to be
+ * given back with `texture_release`. */
+Texture *texture_acquire(RenderContext *ctx, const char *path,
+                         const SDL_Rect *region) {
 
-    f32 block_w = 1.0 / 16.0;
-    f32 block_h = 1.0 / 9.0;
-    Object *obj = object_alloc(ctx);
+    TextureCache *cache = &ctx->textures;
+    SDL_Rect whole = { 0, 0, 0, 0 };
+    CachedTexture **slot, *entry;
+    SDL_Surface *img, *crop;
+    bool success;
+    u32 key;
 
-    obj->ident = ident;
+    if (region == NULL)
+        region = &whole;
 
-    /* --------------------- assign vertices --------------------- */
-    obj->vertices_count = 4;
-    obj->vertices = vmalloc(obj->vertices_count * sizeof(Vertex));
+    key = texture_key(path, region);
 
-    obj->vertices[0].pos[0] = -1.0 + x * block_w;
-    obj->vertices[0].pos[1] = -1.0 + y * block_h;
-    obj->vertices[0].tex[0] = 0.0;
-    obj->vertices[0].tex[1] = 0.0;
+    if ((cache->count + 1) * 4 > cache->capacity * 3)
+        texture_cache_grow(cache);
 
-    obj->vertices[1].pos[0] = -1.0 + (x + 1) * block_w;
-    obj->vertices[1].pos[1] = -1.0 + y * block_h;
-    obj->vertices[1].tex[0] = 1.0;
-    obj->vertices[1].tex[1] = 0.0;
+    slot = texture_cache_find(cache, path, region, key);
 
-    obj->vertices[2].pos[0] = -1.0 + (x + 1) * block_w;
-    obj->vertices[2].pos[1] = -1.0 + (y + 1) * block_h;
-    obj->vertices[2].tex[0] = 1.0;
-    obj->vertices[2].tex[1] = 1.0;
+    if (*slot) {
+        (*slot)->refs++;
+        return &(*slot)->texture;
+    }
 
-    obj->vertices[3].pos[0] = -1.0 + x * block_w;
-    obj->vertices[3].pos[1] = -1.0 + (y + 1) * block_h;
-    obj->vertices[3].tex[0] = 0.0;
-    obj->vertices[3].tex[1] = 1.0;
+    if (!(img = sdl_load_image(ctx, path))) {
+        error("failed to load image: '%s'", path);
+        return NULL;
+    }
 
-    if (!vk_vertices_create(ctx, obj, OBJECT_TILE)) {
-        error("failed to create GPU vertices buffer");
-        return false;
+    if (region->w != 0 && region->h != 0) {
+        crop = sdl_surface_crop(img, region);
+        SDL_FreeSurface(img);
+
+        if (!(img = crop)) {
+            error("failed to crop image: '%s'", path);
+            return NULL;
+        }
     }
 
-    if (!vk_image_from_surface(ctx, &obj->texture, tile)) {
+    entry = vmalloc(sizeof(CachedTexture));
+    success = vk_image_from_surface(ctx, &entry->texture, img);
+    SDL_FreeSurface(img);
+
+    if (!success) {
         error("failed to create image");
-        return false;
+        free(entry);
+        return NULL;
     }
 
-    if (!vk_image_sampler_create(ctx, &obj->texture)) {
+    // neither step leaves anything behind when it fails, only the image
+    // itself has to be unwound
+    if (!vk_image_sampler_create(ctx, &entry->texture)) {
         error("failed to create image sampler");
-        return false;
+        vk_image_destroy(ctx, &entry->texture);
+        free(entry);
+        return NULL;
     }
 
-    if (!vk_descriptor_sets_create(ctx, &obj->texture)) {
+    if (!vk_descriptor_sets_create(ctx, &entry->texture)) {
         error("failed to create descriptor sets");
-        return false;
+        vk_image_destroy(ctx, &entry->texture);
+        free(entry);
+        return NULL;
     }
 
-    return true;
-};
+    entry->key = key;
+    entry->path = vmalloc(strlen(path) + 1);
+    strcpy(entry->path, path);
+    entry->region = *region;
+    entry->refs = 1;
 
-/* Appends object to list of objects
+    *slot = entry;
+    cache->count++;
+    trace("cached texture '%s'", path);
+
+    return &entry->texture;
+}
+
+/* Gives back a texture from `texture_acquire`.
+ *
+ * Unreferenced textures stay on the GPU so that loading the same image
+ * again, such as reopening the escape menu, doesn't go back to disk. */
+void texture_release(RenderContext *ctx, Texture *tex) {
+    TextureCache *cache = &ctx->textures;
+    CachedTexture *entry;
+
+    entry = (CachedTexture *)((u8 *)tex - offsetof(CachedTexture, texture));
+
+    if (cache->count == 0 ||
+        *texture_cache_find(cache, entry->path, &entry->region, entry->key) != entry) {
+        error("released a texture that isn't cached");
+        return;
+    }
+
+    if (entry->refs == 0)
+        warn("texture '%s' released more often than acquired", entry->path);
+    else
+        entry->refs--;
+}
+
+/* Destroys every cached texture, referenced or not. */
+void textures_destroy(RenderContext *ctx) {
+    TextureCache *cache = &ctx->textures;
+
+    for (u32 idx = 0; idx < cache->capacity; idx++) {
+        CachedTexture *entry = cache->entries[idx];
+
+        if (!entry)
+            continue;
+
+        vk_texture_destroy(ctx, &entry->texture);
+        free(entry->path);
+        free(entry);
+    }
+
+    free(cache->entries);
+    cache->entries = NULL;
+    cache->count = 0;
+    cache->capacity = 0;
+}
+
+/* Takes a free slot of the object store and appends an object to the dense
+ * arrays, growing them if they're full. Returns the object's dense index. */
+u32 object_alloc(RenderContext *ctx, ObjectHandle *handle) {
+    ObjectStore *store = &ctx->objects;
+    u32 slot, dense;
+
+    if (store->free_count > 0) {
+        slot = store->free_slots[--store->free_count];
+    } else {
+        if (store->slot_count == store->slot_alloc_count) {
+            store->slot_alloc_count = store->slot_alloc_count * 2 + 8;
+
+            store->slots = vrealloc(
+                store->slots,
+                store->slot_alloc_count * sizeof(ObjectSlot)
+            );
+
+            store->free_slots = vrealloc(
+                store->free_slots,
+                store->slot_alloc_count * sizeof(u32)
+            );
+        }
+
+        slot = store->slot_count++;
+        store->slots[slot].generation = 1;
+    }
+
+    // initially enough for a player and an exit menu
+    if (store->count == store->alloc_count) {
+        u32 count = store->alloc_count * 2 + 8;
+
+        store->idents = vrealloc(store->idents, count * sizeof(u32));
+        store->owners = vrealloc(store->owners, count * sizeof(u32));
+        store->sequences = vrealloc(store->sequences, count * sizeof(u64));
+        store->transforms = vrealloc(
+            store->transforms,
+            count * sizeof(ObjectTransform)
+        );
+        store->previous = vrealloc(
+            store->previous,
+            count * sizeof(ObjectTransform)
+        );
+        store->bounds = vrealloc(store->bounds, count * sizeof(ObjectBounds));
+        store->textures = vrealloc(store->textures, count * sizeof(Texture *));
+        store->objects = vrealloc(store->objects, count * sizeof(Object));
+
+        store->alloc_count = count;
+    }
+
+    dense = store->count++;
+    store->slots[slot].dense = dense;
+    store->owners[dense] = slot;
+    store->sequences[dense] = store->next_sequence++;
+
+    handle->index = slot;
+    handle->generation = store->slots[slot].generation;
+
+    return dense;
+}
+
+/* Returns the entry holding `ident` or the empty entry it would go in. */
+ObjectIndexEntry *object_index_find(ObjectStore *store, u32 ident) {
+    u32 mask = store->index_capacity - 1;
+
+    // identifiers are already hashes
+    for (u32 idx = ident & mask;; idx = (idx + 1) & mask) {
+        ObjectIndexEntry *entry = &store->index[idx];
+
+        if (entry->handle.generation == 0 || entry->ident == ident)
+            return entry;
+    }
+}
+
+/* Points `ident` to `handle`, replacing older objects with the same ident. */
+void object_index_insert(ObjectStore *store, u32 ident, ObjectHandle handle) {
+    ObjectIndexEntry *entry;
+
+    if ((store->index_count + 1) * 4 > store->index_capacity * 3) {
+        ObjectIndexEntry *old = store->index;
+        u32 old_capacity = store->index_capacity;
+
+        store->index_capacity = old_capacity ? old_capacity * 2 : 16;
+        store->index = vcalloc(store->index_capacity * sizeof(ObjectIndexEntry));
+
+        for (u32 idx = 0; idx < old_capacity; idx++) {
+            if (old[idx].handle.generation != 0)
+                *object_index_find(store, old[idx].ident) = old[idx];
+        }
+
+        free(old);
+    }
+
+    entry = object_index_find(store, ident);
+
+    if (entry->handle.generation == 0)
+        store->index_count++;
+
+    entry->ident = ident;
+    entry->handle = handle;
+}
+
+/* Removes `ident` from the index, shifting back the entries that probed
+ * past it so lookups never stop early. */
+void object_index_remove(ObjectStore *store, u32 ident) {
+    u32 mask = store->index_capacity - 1;
+    ObjectIndexEntry *entry = object_index_find(store, ident);
+    u32 hole = entry - store->index;
+
+    if (entry->handle.generation == 0)
+        return;
+
+    for (u32 next = (hole + 1) & mask;; next = (next + 1) & mask) {
+        ObjectIndexEntry *moved = &store->index[next];
+
+        if (moved->handle.generation == 0)
+            break;
+
+        // only move entries whose home slot isn't between the hole and them
+        if (((next - moved->ident) & mask) >= ((next - hole) & mask)) {
+            store->index[hole] = *moved;
+            hole = next;
+        }
+    }
+
+    store->index[hole].handle.generation = 0;
+    store->index_count--;
+}
+
+/* Appends a quad to the batch.
  *
  * pos is an array of positions:
  * [top-left, top-right, bottom-right, bottom-left]
  *
- * img_path is the texture to be overlayed on the object */
-bool object_create(RenderContext *ctx, f32 pos[4][2], const char *img_path) {
-    Object *obj = object_alloc(ctx);
+ * uv is the region of the batch's texture to be overlayed on the quad:
+ * [top-left, bottom-right] */
+void sprite_batch_push(SpriteBatch *batch, f32 pos[4][2], f32 uv[2][2]) {
+    Vertex *vertices;
+
+    if (batch->quad_count == batch->quad_alloc_count) {
+        batch->quad_alloc_count = batch->quad_alloc_count * 2 + 32;
+        batch->vertices = vrealloc(
+            batch->vertices,
+            batch->quad_alloc_count * 4 * sizeof(Vertex)
+        );
+    }
+
+    vertices = &batch->vertices[batch->quad_count * 4];
+    batch->quad_count++;
+
+    vertices[0].pos[0] = pos[0][0];
+    vertices[0].pos[1] = pos[0][1];
+    vertices[0].tex[0] = uv[0][0];
+    vertices[0].tex[1] = uv[0][1];
 
-    obj->ident = HASH(img_path);
+    vertices[1].pos[0] = pos[1][0];
+    vertices[1].pos[1] = pos[1][1];
+    vertices[1].tex[0] = uv[1][0];
+    vertices[1].tex[1] = uv[0][1];
+
+    vertices[2].pos[0] = pos[2][0];
+    vertices[2].pos[1] = pos[2][1];
+    vertices[2].tex[0] = uv[1][0];
+    vertices[2].tex[1] = uv[1][1];
+
+    vertices[3].pos[0] = pos[3][0];
+    vertices[3].pos[1] = pos[3][1];
+    vertices[3].tex[0] = uv[0][0];
+    vertices[3].tex[1] = uv[1][1];
+}
+
+/* Expands every tile of a chunk into a quad on the CPU, the equivalent of
+ * what `tile.vert` does for instanced layers. */
+void level_chunk_batch(RenderContext *ctx, TileChunk *chunk) {
+    for (u32 idx = 0; idx < chunk->tile_count; idx++) {
+        const TileInstance *tile = &chunk->tiles[idx];
+        const LevelUv *sprite = &ctx->level.uvs[tile->tile];
+        f32 pos[4][2], uv[2][2];
+
+        pos[0][0] = tile->pos[0];
+        pos[0][1] = tile->pos[1];
+        pos[1][0] = tile->pos[0] + 1;
+        pos[1][1] = tile->pos[1];
+        pos[2][0] = tile->pos[0] + 1;
+        pos[2][1] = tile->pos[1] + 1;
+        pos[3][0] = tile->pos[0];
+        pos[3][1] = tile->pos[1] + 1;
+
+        // region of the atlas covered by the sprite
+        uv[0][0] = sprite->min[0];
+        uv[0][1] = sprite->min[1];
+        uv[1][0] = sprite->max[0];
+        uv[1][1] = sprite->max[1];
+
+        sprite_batch_push(&chunk->batch, pos, uv);
+    }
+}
+
+/* Appends object to list of objects
+ *
+ * pos is an array of positions:
+ * [top-left, top-right, bottom-right, bottom-left]
+ *
+ * img_path is the texture to be overlayed on the object
+ *
+ * handle is set to the new object when it isn't NULL, nothing is left of the
+ * object when creation fails */
+bool object_create(RenderContext *ctx, f32 pos[4][2], const char *img_path,
+                   ObjectHandle *handle) {
+
+    ObjectStore *store = &ctx->objects;
+    ObjectHandle created;
+    ObjectBounds *bounds;
+    Object *obj;
+    u32 dense;
+
+    dense = object_alloc(ctx, &created);
+    obj = &store->objects[dense];
+    bounds = &store->bounds[dense];
+
+    store->idents[dense] = hash(img_path);
+    store->transforms[dense] = (ObjectTransform) {{ 0.0, 0.0 }};
+    store->previous[dense] = store->transforms[dense];
+    store->textures[dense] = NULL;
+    object_index_insert(store, store->idents[dense], created);
 
     /* --------------------- assign vertices --------------------- */
+    obj->offset[0] = 0.0;
+    obj->offset[1] = 0.0;
     obj->vertices_count = 4;
     obj->vertices = vmalloc(obj->vertices_count * sizeof(Vertex));
 
@@ -201,196 +520,368 @@ bool object_create(RenderContext *ctx, f32 pos[4][2], const char *img_path) {
     obj->vertices[3].tex[0] = 0.0;
     obj->vertices[3].tex[1] = 1.0;
 
-    if (!vk_vertices_create(ctx, obj, OBJECT_PLAYER)) {
-        error("failed to create GPU vertices buffer");
-        return false;
-    }
+    bounds->min[0] = bounds->max[0] = pos[0][0];
+    bounds->min[1] = bounds->max[1] = pos[0][1];
 
-    if (!vk_image_create(ctx, &obj->texture, img_path)) {
-        error("failed to create image");
-        return false;
+    for (u32 idx = 1; idx < 4; idx++) {
+        if (pos[idx][0] < bounds->min[0]) bounds->min[0] = pos[idx][0];
+        if (pos[idx][1] < bounds->min[1]) bounds->min[1] = pos[idx][1];
+        if (pos[idx][0] > bounds->max[0]) bounds->max[0] = pos[idx][0];
+        if (pos[idx][1] > bounds->max[1]) bounds->max[1] = pos[idx][1];
     }
 
-    if (!vk_image_sampler_create(ctx, &obj->texture)) {
-        error("failed to create image sampler");
+    if (!vk_vertices_create(ctx, obj)) {
+        error("failed to create GPU vertices buffer");
+        obj->vertices_buf = VK_NULL_HANDLE;
+        object_remove(ctx, created);
         return false;
     }
 
-    if (!vk_descriptor_sets_create(ctx, &obj->texture)) {
-        error("failed to create descriptor sets");
+    if (!(store->textures[dense] = texture_acquire(ctx, img_path, NULL))) {
+        error("failed to create texture");
+        object_remove(ctx, created);
         return false;
     }
 
+    if (handle)
+        *handle = created;
+
     return true;
 };
 
-void object_destroy(RenderContext *ctx, Object *obj) {
-    // destroy vertices
+void object_destroy(RenderContext *ctx, u32 dense) {
+    ObjectStore *store = &ctx->objects;
+    Object *obj = &store->objects[dense];
+
+    // destroy vertices, the buffer is missing if `object_create` failed
     free(obj->vertices);
-    vkFreeMemory(ctx->driver, obj->vertices_mem, NULL);
-    vkDestroyBuffer(ctx->driver, obj->vertices_buf, NULL);
-
-    // destroy texture
-    vkDestroyImageView(ctx->driver, obj->texture.view, NULL);
-    vkDestroyImage(ctx->driver, obj->texture.image, NULL);
-    vkFreeMemory(ctx->driver, obj->texture.mem, NULL);
-    vkDestroySampler(ctx->driver, obj->texture.sampler, NULL);
+
+    if (obj->vertices_buf != VK_NULL_HANDLE) {
+        vk_memory_free(ctx, &obj->vertices_mem);
+        vkDestroyBuffer(ctx->driver, obj->vertices_buf, NULL);
+    }
+
+    if (store->textures[dense])
+        texture_release(ctx, store->textures[dense]);
 }
 
 /* Destroys all objects at once. */
 void objects_destroy(RenderContext *ctx) {
-    for (u32 idx = 0; idx < ctx->object_count; idx++)
-        object_destroy(ctx, &ctx->objects[idx]);
+    ObjectStore *store = &ctx->objects;
+
+    for (u32 idx = 0; idx < store->count; idx++)
+        object_destroy(ctx, idx);
+
+    free(store->slots);
+    free(store->free_slots);
+    free(store->idents);
+    free(store->owners);
+    free(store->sequences);
+    free(store->transforms);
+    free(store->previous);
+    free(store->bounds);
+    free(store->textures);
+    free(store->objects);
+    free(store->index);
 
-    free(ctx->objects);
     info("game entities destroyed");
 }
 
-Object *object_find(RenderContext *ctx, u32 ident) {
-    Object *obj = NULL;
+/* Returns the dense index of the object behind `handle`, or `OBJECT_NONE`
+ * if it has been destroyed.
+ *
+ * The index is only valid till the next object gets destroyed. */
+u32 object_get(RenderContext *ctx, ObjectHandle handle) {
+    ObjectStore *store = &ctx->objects;
+    ObjectSlot *slot;
+
+    if (handle.index >= store->slot_count)
+        return OBJECT_NONE;
+
+    slot = &store->slots[handle.index];
 
-    for (u32 idx = 0; idx < ctx->object_count; idx++)
-        if (ctx->objects[idx].ident == ident)
-            obj = &ctx->objects[idx];
+    if (slot->generation != handle.generation)
+        return OBJECT_NONE;
 
-    return obj;
+    return slot->dense;
+}
+
+/* Returns the most recently created object with `ident`, or a handle that
+ * `object_get` never resolves if there's none. */
+ObjectHandle object_find(RenderContext *ctx, u32 ident) {
+    ObjectStore *store = &ctx->objects;
+    ObjectHandle none = { 0, 0 };
+
+    if (store->index_count == 0)
+        return none;
+
+    return object_index_find(store, ident)->handle;
 }
 
 /* Tries to destroy an object and returns whether or not it succeeded.
  *
- * Copies the last elements of the array into the deleted spot. */
-bool object_find_destroy(RenderContext *ctx, u32 ident) {
-    Object *obj = object_find(ctx, ident);
-
-    if (obj == NULL || ctx->object_count == 0)
+ * The last object of the dense arrays is moved into the hole and the slot
+ * is recycled by the next object created, handles to the destroyed object
+ * stop resolving. */
+bool object_remove(RenderContext *ctx, ObjectHandle handle) {
+    ObjectStore *store = &ctx->objects;
+    u32 dense = object_get(ctx, handle);
+    u32 ident, last, newest;
+
+    if (dense == OBJECT_NONE)
         return false;
 
     // wait for driver to finish queued work then destroy object resources
     vkDeviceWaitIdle(ctx->driver);
-    object_destroy(ctx, obj);
+    object_destroy(ctx, dense);
+
+    ident = store->idents[dense];
+    last = --store->count;
+
+    if (dense != last) {
+        store->idents[dense] = store->idents[last];
+        store->owners[dense] = store->owners[last];
+        store->sequences[dense] = store->sequences[last];
+        store->transforms[dense] = store->transforms[last];
+        store->previous[dense] = store->previous[last];
+        store->bounds[dense] = store->bounds[last];
+        store->textures[dense] = store->textures[last];
+        store->objects[dense] = store->objects[last];
+
+        store->slots[store->owners[dense]].dense = dense;
+    }
+
+    store->slots[handle.index].dense = OBJECT_NONE;
+
+    if (++store->slots[handle.index].generation == 0)
+        store->slots[handle.index].generation = 1;
 
-    memcpy(obj, &ctx->objects[ctx->object_count - 1], sizeof(Object));
-    ctx->object_count--;
+    store->free_slots[store->free_count++] = handle.index;
+
+    if (object_index_find(store, ident)->handle.index != handle.index)
+        return true;
+
+    // point the ident back to the newest other object created with it
+    object_index_remove(store, ident);
+    newest = OBJECT_NONE;
+
+    for (u32 idx = 0; idx < store->count; idx++) {
+        if (store->idents[idx] != ident)
+            continue;
+
+        if (newest == OBJECT_NONE ||
+            store->sequences[idx] > store->sequences[newest])
+            newest = idx;
+    }
+
+    if (newest != OBJECT_NONE) {
+        u32 slot = store->owners[newest];
+        ObjectHandle found = { slot, store->slots[slot].generation };
+
+        object_index_insert(store, ident, found);
+    }
 
     return true;
 }
 
-/* Transform object position by x and y amount. */
-void object_transform(Object *obj, f32 x, f32 y) {
-    for (u32 idx = 0; idx < obj->vertices_count; idx++) {
-        obj->vertices[idx].pos[0] += x;
-        obj->vertices[idx].pos[1] += y;
-    }
+/* Destroys the most recently created object with `ident`. */
+bool object_find_destroy(RenderContext *ctx, u32 ident) {
+    return object_remove(ctx, object_find(ctx, ident));
+}
+
+/* Transform object position by x and y amount.
+ *
+ * Only the simulated position moves, the object is drawn there once
+ * `objects_interpolate` catches up to it. */
+void object_transform(RenderContext *ctx, u32 dense, f32 x, f32 y) {
+    ObjectStore *store = &ctx->objects;
+
+    store->transforms[dense].pos[0] += x;
+    store->transforms[dense].pos[1] += y;
+
+    store->bounds[dense].min[0] += x;
+    store->bounds[dense].min[1] += y;
+    store->bounds[dense].max[0] += x;
+    store->bounds[dense].max[1] += y;
 }
 
-/* Returns surfaces for all the different tileset tiles */
-SDL_Surface **level_tileset_load(RenderContext *ctx, const char *path) {
-    SDL_Surface **surfaces = vmalloc(25 * 25 * sizeof(SDL_Surface));
-    SDL_Surface *tileset = sdl_load_image("./assets/tileset.bmp");
+/* Remembers where every object is at the start of a simulation tick. */
+void objects_tick(RenderContext *ctx) {
+    ObjectStore *store = &ctx->objects;
 
-    for (u32 x = 0; x < 25; x++) {
-        for (u32 y = 0; y < 25; y++) {
+    memcpy(store->previous, store->transforms, store->count * sizeof(ObjectTransform));
+}
 
-            SDL_Rect region = {
-                y * 16, x * 16,
-                16, 16
-            };
+/* Places every object `alpha` of the way from where it was on the previous
+ * simulation tick to where it is now. */
+void objects_interpolate(RenderContext *ctx, f32 alpha) {
+    ObjectStore *store = &ctx->objects;
 
-            surfaces[x * 25 + y] = tileset_sprite_load(
-                ctx,
-                tileset,
-                &region
-            );
+    for (u32 idx = 0; idx < store->count; idx++) {
+        Object *obj = &store->objects[idx];
+        f32 *from = store->previous[idx].pos;
+        f32 *to = store->transforms[idx].pos;
+        f32 x = from[0] + (to[0] - from[0]) * alpha;
+        f32 y = from[1] + (to[1] - from[1]) * alpha;
 
-            if (!surfaces[x * 25 + y]) {
-                SDL_FreeSurface(tileset);
-                error("failed to load a sprite from tileset: '%s'", path);
-                return NULL;
-            }
-        }
+        if (x == obj->offset[0] && y == obj->offset[1])
+            continue;
+
+        obj->offset[0] = x;
+        obj->offset[1] = y;
+        vk_vertices_update(ctx, obj);
     }
+}
 
-    SDL_FreeSurface(tileset);
+/* Area an object covers where it's drawn, which trails behind its
+ * simulated `bounds` until `objects_interpolate` catches up. */
+void object_drawn_bounds(RenderContext *ctx, u32 dense, ObjectBounds *bounds) {
+    ObjectStore *store = &ctx->objects;
+    Object *obj = &store->objects[dense];
 
-    return surfaces;
-}
+    for (u32 axis = 0; axis < 2; axis++) {
+        f32 shift = obj->offset[axis] - store->transforms[dense].pos[axis];
 
-void level_tileset_destroy(SDL_Surface **tileset) {
-    for (u32 idx = 0; idx < 25 * 25; idx++) {
-        SDL_FreeSurface(tileset[idx]);
+        bounds->min[axis] = store->bounds[dense].min[axis] + shift;
+        bounds->max[axis] = store->bounds[dense].max[axis] + shift;
     }
+}
+
+/* Moves the camera so `x` and `y` are in the middle of the screen, without
+ * showing anything past the edges of the level. */
+void camera_center(RenderContext *ctx, f32 x, f32 y) {
+    Camera *camera = &ctx->camera;
+
+    for (u32 axis = 0; axis < 2; axis++) {
+        f32 extent = 2.0 / camera->scale[axis];
+        f32 level = (f32)ctx->collision.size[axis];
+        f32 pos = (axis == 0 ? x : y) - extent / 2.0;
 
-    free(tileset);
+        if (pos > level - extent)
+            pos = level - extent;
+
+        // levels smaller than the screen stick to the top-left corner
+        if (pos < 0.0)
+            pos = 0.0;
+
+        camera->pos[axis] = pos;
+    }
 }
 
-/* Creates objects for each of the squares listed in a level map file.
- *
- * Takes a path to an CSV file of 16 rows and 9 columns. */
-bool level_map_load(RenderContext *ctx,
-                    const char *level_path,
-                    const char *tileset_path) {
+/* Returns whether any part of `bounds` is on screen. */
+bool camera_sees(RenderContext *ctx, const ObjectBounds *bounds) {
+    Camera *camera = &ctx->camera;
 
-    SDL_Surface **tileset;
-    FILE *level;
-    u32 x = 0, y = 0;
+    for (u32 axis = 0; axis < 2; axis++) {
+        f32 extent = 2.0 / camera->scale[axis];
 
-    if (!(tileset = level_tileset_load(ctx, tileset_path))) {
-        error("failed to load tileset: '%s'", level_path);
-        return false;
+        if (bounds->max[axis] < camera->pos[axis] ||
+            bounds->min[axis] > camera->pos[axis] + extent)
+            return false;
     }
 
-    if (!(level = fopen(level_path, "r"))) {
-        error("failed to read level map: '%s'", level_path);
-        level_tileset_destroy(tileset);
+    return true;
+}
+
+/* Uploads the tileset of the loaded level as a single texture that tiles
+ * index into.
+ *
+ * The number of sprites follows from the size of the image and the sprite
+ * size the level was compiled with. Pixels past the last whole sprite are
+ * cropped off so sprites line up with the texture coordinates. */
+bool level_atlas_load(RenderContext *ctx) {
+    Atlas *atlas = &ctx->atlas;
+    const LevelHeader *header = ctx->level.header;
+    SDL_Surface *tileset = sdl_load_image(ctx, ctx->level.tileset);
+    SDL_Rect whole;
+
+    if (!tileset) {
+        error("failed to load tileset: '%s'", ctx->level.tileset);
         return false;
     }
 
-    // read csv
-    for (;;) {
-        u32 idx;
-        int args = fscanf(level, "%d", &idx);
-        int delim = fgetc(level);
-
-        if (args != 1 && delim != ',' && delim != '\n' && delim != '\0') {
-            level_tileset_destroy(tileset);
-            fclose(level);
-            return true;
-        }
+    atlas->columns = tileset->w / header->tile_size[0];
+    atlas->rows = tileset->h / header->tile_size[1];
+
+    if (atlas->columns != header->atlas_size[0] || atlas->rows != header->atlas_size[1]) {
+        error(
+            "tileset '%s' has %d by %d sprites, the level was compiled against %d by %d",
+            ctx->level.tileset,
+            atlas->columns,
+            atlas->rows,
+            header->atlas_size[0],
+            header->atlas_size[1]
+        );
+        SDL_FreeSurface(tileset);
+        return false;
+    }
 
-        if (idx == -1) {
-            x++;
+    whole = (SDL_Rect) {
+        .w = atlas->columns * header->tile_size[0],
+        .h = atlas->rows * header->tile_size[1],
+    };
 
-            if (delim == '\n') {
-                y++;
-                x = 0;
-            }
+    if (whole.w != tileset->w || whole.h != tileset->h) {
+        SDL_Surface *crop = sdl_surface_crop(tileset, &whole);
+        SDL_FreeSurface(tileset);
 
-            continue;
+        if (!(tileset = crop)) {
+            error("failed to crop tileset: '%s'", ctx->level.tileset);
+            return false;
         }
+    }
 
-        trace("idx: %d, x: %d, y: %d", idx, x, y);
+    ctx->grid.atlas_size[0] = atlas->columns;
+    ctx->grid.atlas_size[1] = atlas->rows;
 
-        if (!object_from_tile(ctx, x, y, tileset[idx], idx)) {
-            level_tileset_destroy(tileset);
-            fclose(level);
-            error("failed to create object from tile");
-            return false;
-        }
+    // collision cells line up with the tiles
+    ctx->collision.cell_size[0] = 1.0;
+    ctx->collision.cell_size[1] = 1.0;
+    ctx->collision.origin[0] = 0.0;
+    ctx->collision.origin[1] = 0.0;
 
-        if (delim == '\n') {
-            y++;
-            x = 0;
-            continue;
-        }
+    if (!vk_image_from_surface(ctx, &atlas->texture, tileset)) {
+        error("failed to create atlas image");
+        SDL_FreeSurface(tileset);
+        return false;
+    }
 
-        if (delim == EOF)
-            break;
+    SDL_FreeSurface(tileset);
 
-        x++;
+    if (!vk_atlas_sampler_create(ctx, &atlas->texture)) {
+        error("failed to create atlas image sampler");
+        return false;
     }
 
-    level_tileset_destroy(tileset);
-    fclose(level);
+    if (!vk_descriptor_sets_create(ctx, &atlas->texture)) {
+        error("failed to create atlas descriptor sets");
+        return false;
+    }
 
     return true;
 }
+
+void level_atlas_destroy(RenderContext *ctx) {
+    vk_texture_destroy(ctx, &ctx->atlas.texture);
+    collision_grid_destroy(&ctx->collision);
+}
+
+/* Destroys every layer loaded by `level_load`, stopping the streaming
+ * thread first since it reads from them. */
+void level_layers_destroy(RenderContext *ctx) {
+    level_stream_stop(ctx);
+
+    for (u32 idx = 0; idx < ctx->layer_count; idx++) {
+        TileLayer *layer = &ctx->layers[idx];
+
+        for (u32 chunk = 0; chunk < layer->chunk_count; chunk++)
+            vk_tile_chunk_destroy(ctx, &layer->chunks[chunk]);
+
+        free(layer->chunks);
+    }
+
+    free(ctx->layers);
+    ctx->layers = NULL;
+    ctx->layer_count = 0;
+    vk_static_layers_invalidate(ctx);
+}
@@ -3,9 +3,14 @@
 layout(location = 0) in vec2 position;
 layout(location = 1) in vec2 in_uv;
 
+layout(set = 1, binding = 0) uniform Camera {
+    vec2 pos;
+    vec2 scale;
+} camera;
+
 layout(location = 0) out vec2 frag_uv;
 
 void main() {
-    gl_Position = vec4(position, 0.0, 1.0);
+    gl_Position = vec4((position - camera.pos) * camera.scale - 1.0, 0.0, 1.0);
     frag_uv = in_uv;
 }
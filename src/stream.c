@@ -0,0 +1,423 @@
+#include "utils.h"
+#include "render.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Smallest page size of the platforms the level can be mapped on */
+#define STREAM_PAGE_SIZE 4096
+
+/* Appends a request to a queue, growing it if needed. */
+void chunk_queue_push(ChunkRequest **queue, u32 *count, u32 *alloc_count,
+                      const ChunkRequest *req) {
+
+    if (*count == *alloc_count) {
+        *alloc_count = *alloc_count * 2 + 16;
+        *queue = vrealloc(*queue, *alloc_count * sizeof(ChunkRequest));
+    }
+
+    (*queue)[(*count)++] = *req;
+}
+
+/* Touches every page of a chunk's tiles within the mapped level, faulting
+ * them in from the disk before the main thread uploads them. */
+void chunk_request_read(ChunkRequest *req) {
+    const volatile u8 *bytes = (const volatile u8 *)req->tiles;
+    usize size = req->tile_count * sizeof(TileInstance);
+
+    for (usize offset = 0; offset < size; offset += STREAM_PAGE_SIZE)
+        (void)bytes[offset];
+
+    // the last page when the tiles don't start on a page boundary
+    if (size != 0)
+        (void)bytes[size - 1];
+}
+
+/* Takes every queued request at once and pages them in while the lock is
+ * released, handing each chunk back as soon as it's resident. */
+int stream_worker(void *data) {
+    ChunkStreamer *stream = data;
+
+    for (;;) {
+        ChunkRequest *requests;
+        u32 count;
+
+        SDL_LockMutex(stream->lock);
+
+        while (!stream->quit && stream->request_count == 0)
+            SDL_CondWait(stream->wake, stream->lock);
+
+        if (stream->quit) {
+            SDL_UnlockMutex(stream->lock);
+            return 0;
+        }
+
+        requests = stream->requests;
+        count = stream->request_count;
+        stream->busy += count;
+        stream->requests = NULL;
+        stream->request_count = 0;
+        stream->request_alloc_count = 0;
+
+        SDL_UnlockMutex(stream->lock);
+
+        for (u32 idx = 0; idx < count; idx++) {
+            chunk_request_read(&requests[idx]);
+
+            SDL_LockMutex(stream->lock);
+            chunk_queue_push(
+                &stream->results,
+                &stream->result_count,
+                &stream->result_alloc_count,
+                &requests[idx]
+            );
+            stream->busy--;
+            SDL_CondSignal(stream->done);
+            SDL_UnlockMutex(stream->lock);
+        }
+
+        free(requests);
+    }
+}
+
+bool level_stream_start(RenderContext *ctx) {
+    ChunkStreamer *stream = &ctx->stream;
+
+    stream->lock = SDL_CreateMutex();
+    stream->wake = SDL_CreateCond();
+    stream->done = SDL_CreateCond();
+
+    if (!stream->lock || !stream->wake || !stream->done) {
+        error("failed to create streaming primitives: %s", SDL_GetError());
+        return false;
+    }
+
+    stream->thread = SDL_CreateThread(stream_worker, "level stream", stream);
+
+    if (!stream->thread) {
+        error("failed to create streaming thread: %s", SDL_GetError());
+        return false;
+    }
+
+    return true;
+}
+
+TileChunk *level_chunk_find(TileLayer *layer, u32 x, u32 y) {
+    for (u32 idx = 0; idx < layer->chunk_count; idx++) {
+        TileChunk *chunk = &layer->chunks[idx];
+
+        if (chunk->pos[0] == x && chunk->pos[1] == y)
+            return chunk;
+    }
+
+    return NULL;
+}
+
+/* Range of chunks within `margin` chunks of the screen, clamped to the
+ * level map. Returns false if the layer has no chunks at all. */
+bool level_chunk_range(RenderContext *ctx, TileLayer *layer, i32 margin,
+                       u32 min[2], u32 max[2]) {
+
+    Camera *camera = &ctx->camera;
+
+    for (u32 axis = 0; axis < 2; axis++) {
+        i32 lo = (i32)(camera->pos[axis] / CHUNK_SIZE) - margin;
+        i32 hi = (i32)((camera->pos[axis] + 2.0 / camera->scale[axis]) / CHUNK_SIZE) + margin;
+        i32 last = ((i32)layer->size[axis] - 1) / CHUNK_SIZE;
+
+        if (layer->size[axis] == 0)
+            return false;
+
+        min[axis] = lo < 0 ? 0 : lo;
+        max[axis] = hi > last ? last : hi;
+    }
+
+    return true;
+}
+
+/* Destroys chunks evicted long enough ago that every frame which could have
+ * drawn them has finished. */
+void level_chunks_retire(RenderContext *ctx) {
+    ChunkStreamer *stream = &ctx->stream;
+    u32 idx = 0;
+
+    while (idx < stream->retired_count) {
+        TileChunk *chunk = &stream->retired[idx];
+
+        if (ctx->frame_count < chunk->evicted_frame + ctx->frames_in_flight) {
+            idx++;
+            continue;
+        }
+
+        vk_tile_chunk_destroy(ctx, chunk);
+        stream->retired[idx] = stream->retired[--stream->retired_count];
+    }
+}
+
+/* Evicts a chunk of a layer, keeping it's GPU resources alive until the
+ * frames in flight are done with them. */
+void level_chunk_evict(RenderContext *ctx, TileLayer *layer, u32 idx) {
+    ChunkStreamer *stream = &ctx->stream;
+    TileChunk *chunk = &layer->chunks[idx];
+
+    chunk->evicted_frame = ctx->frame_count;
+
+    if (stream->retired_count == stream->retired_alloc_count) {
+        stream->retired_alloc_count = stream->retired_alloc_count * 2 + 16;
+        stream->retired = vrealloc(
+            stream->retired,
+            stream->retired_alloc_count * sizeof(TileChunk)
+        );
+    }
+
+    stream->retired[stream->retired_count++] = *chunk;
+    layer->chunks[idx] = layer->chunks[--layer->chunk_count];
+}
+
+/* Evicts the chunks of a layer that are out of reach and queues the ones
+ * coming into reach. Returns whether the layer's chunks changed.
+ *
+ * Chunks are evicted a chunk further out than they're loaded, so moving
+ * back and forth over a chunk's edge doesn't reload it every time. */
+bool level_layer_stream(RenderContext *ctx, u32 layer_idx) {
+    ChunkStreamer *stream = &ctx->stream;
+    TileLayer *layer = &ctx->layers[layer_idx];
+    u32 want_min[2], want_max[2], keep_min[2], keep_max[2];
+    bool evicted = false, queued = false;
+    u32 idx = 0;
+
+    if (!level_chunk_range(ctx, layer, STREAM_DISTANCE, want_min, want_max))
+        return false;
+
+    level_chunk_range(ctx, layer, STREAM_DISTANCE + 1, keep_min, keep_max);
+
+    while (idx < layer->chunk_count) {
+        TileChunk *chunk = &layer->chunks[idx];
+
+        if (chunk->pos[0] >= keep_min[0] && chunk->pos[0] <= keep_max[0] &&
+            chunk->pos[1] >= keep_min[1] && chunk->pos[1] <= keep_max[1]) {
+            idx++;
+            continue;
+        }
+
+        level_chunk_evict(ctx, layer, idx);
+        evicted = true;
+    }
+
+    SDL_LockMutex(stream->lock);
+
+    for (u32 y = want_min[1]; y <= want_max[1]; y++) {
+        for (u32 x = want_min[0]; x <= want_max[0]; x++) {
+            const LevelChunk *entry;
+            ChunkRequest req;
+
+            if (level_chunk_find(layer, x, y))
+                continue;
+
+            entry = &layer->level_chunks[y * ctx->level.header->chunks[0] + x];
+            req = (ChunkRequest) {
+                .layer = layer_idx,
+                .pos = { x, y },
+                .tiles = (const TileInstance *)(ctx->level.file.data + entry->offset),
+                .tile_count = entry->tile_count,
+            };
+
+            if (layer->chunk_count == layer->chunk_alloc_count) {
+                layer->chunk_alloc_count = layer->chunk_alloc_count * 2 + 16;
+                layer->chunks = vrealloc(
+                    layer->chunks,
+                    layer->chunk_alloc_count * sizeof(TileChunk)
+                );
+            }
+
+            // drawn as empty until the tiles arrive
+            layer->chunks[layer->chunk_count++] = (TileChunk) {
+                .pos = { x, y },
+                .loaded = false,
+            };
+
+            chunk_queue_push(
+                &stream->requests,
+                &stream->request_count,
+                &stream->request_alloc_count,
+                &req
+            );
+
+            queued = true;
+        }
+    }
+
+    if (queued)
+        SDL_CondSignal(stream->wake);
+
+    SDL_UnlockMutex(stream->lock);
+
+    return evicted || queued;
+}
+
+bool level_tile_valid(const LevelHeader *header, const TileInstance *tile) {
+    return tile->tile < header->atlas_size[0] * header->atlas_size[1] &&
+           tile->pos[0] < header->size[0] &&
+           tile->pos[1] < header->size[1];
+}
+
+/* Drops the tiles of a chunk that are outside of the tileset or the level,
+ * which only a stale or corrupt level has. The chunk keeps reading its
+ * tiles from the mapped level unless one had to be dropped. */
+void level_chunk_check(RenderContext *ctx, TileChunk *chunk) {
+    const LevelHeader *header = ctx->level.header;
+    u32 idx = 0, count;
+
+    while (idx < chunk->tile_count && level_tile_valid(header, &chunk->tiles[idx]))
+        idx++;
+
+    if (idx == chunk->tile_count)
+        return;
+
+    chunk->kept_tiles = vmalloc(chunk->tile_count * sizeof(TileInstance));
+    memcpy(chunk->kept_tiles, chunk->tiles, idx * sizeof(TileInstance));
+    count = idx;
+
+    for (; idx < chunk->tile_count; idx++) {
+        const TileInstance *tile = &chunk->tiles[idx];
+
+        if (!level_tile_valid(header, tile)) {
+            error(
+                "tile %d at %d, %d is out of the tileset's or level's bounds",
+                tile->tile,
+                tile->pos[0],
+                tile->pos[1]
+            );
+            continue;
+        }
+
+        chunk->kept_tiles[count++] = *tile;
+    }
+
+    chunk->tiles = chunk->kept_tiles;
+    chunk->tile_count = count;
+}
+
+/* Hands the chunks paged in by the streaming thread over to their layers
+ * and uploads their tiles straight from the mapped level. Returns whether
+ * any chunk was uploaded.
+ *
+ * Chunks evicted while they were being paged in are skipped, tiles outside
+ * of the tileset or level are dropped. */
+bool level_chunks_receive(RenderContext *ctx) {
+    ChunkStreamer *stream = &ctx->stream;
+    bool batching = ctx->upload.batching;
+    ChunkRequest *results;
+    u32 count;
+
+    SDL_LockMutex(stream->lock);
+
+    results = stream->results;
+    count = stream->result_count;
+    stream->results = NULL;
+    stream->result_count = 0;
+    stream->result_alloc_count = 0;
+
+    SDL_UnlockMutex(stream->lock);
+
+    if (count == 0)
+        return false;
+
+    // upload every chunk with a single submission
+    if (!batching)
+        vk_upload_begin(ctx);
+
+    for (u32 idx = 0; idx < count; idx++) {
+        ChunkRequest *req = &results[idx];
+        TileLayer *layer = &ctx->layers[req->layer];
+        TileChunk *chunk = level_chunk_find(layer, req->pos[0], req->pos[1]);
+
+        if (!chunk || chunk->loaded)
+            continue;
+
+        chunk->tiles = req->tiles;
+        chunk->tile_count = req->tile_count;
+        level_chunk_check(ctx, chunk);
+
+        if (!vk_tile_chunk_create(ctx, chunk)) {
+            error("failed to upload chunk %d, %d", chunk->pos[0], chunk->pos[1]);
+            chunk->tiles = NULL;
+            chunk->tile_count = 0;
+        }
+
+        chunk->loaded = true;
+    }
+
+    if (!batching && !vk_upload_end(ctx))
+        warn("failed to upload streamed chunks");
+
+    free(results);
+    return true;
+}
+
+/* Keeps the chunks around the camera resident, called once per frame
+ * before it's rendered. Chunks are only ever created or destroyed here,
+ * the streaming thread just pages them in. */
+void level_stream(RenderContext *ctx) {
+    bool changed = false;
+
+    level_chunks_retire(ctx);
+    changed |= level_chunks_receive(ctx);
+
+    for (u32 idx = 0; idx < ctx->layer_count; idx++)
+        changed |= level_layer_stream(ctx, idx);
+
+    if (changed)
+        vk_static_layers_invalidate(ctx);
+}
+
+/* Streams the chunks around the camera and blocks until every one of them
+ * has been paged in and uploaded. */
+void level_stream_wait(RenderContext *ctx) {
+    ChunkStreamer *stream = &ctx->stream;
+
+    level_stream(ctx);
+
+    SDL_LockMutex(stream->lock);
+
+    while (stream->request_count != 0 || stream->busy != 0)
+        SDL_CondWait(stream->done, stream->lock);
+
+    SDL_UnlockMutex(stream->lock);
+
+    level_stream(ctx);
+}
+
+/* Stops the streaming thread and destroys every chunk it still holds. */
+void level_stream_stop(RenderContext *ctx) {
+    ChunkStreamer *stream = &ctx->stream;
+
+    if (stream->thread) {
+        SDL_LockMutex(stream->lock);
+        stream->quit = true;
+        SDL_CondSignal(stream->wake);
+        SDL_UnlockMutex(stream->lock);
+
+        SDL_WaitThread(stream->thread, NULL);
+        stream->thread = NULL;
+    }
+
+    for (u32 idx = 0; idx < stream->retired_count; idx++)
+        vk_tile_chunk_destroy(ctx, &stream->retired[idx]);
+
+    free(stream->requests);
+    free(stream->results);
+    free(stream->retired);
+
+    if (stream->done)
+        SDL_DestroyCond(stream->done);
+
+    if (stream->wake)
+        SDL_DestroyCond(stream->wake);
+
+    if (stream->lock)
+        SDL_DestroyMutex(stream->lock);
+
+    *stream = (ChunkStreamer) {};
+}
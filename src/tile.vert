@@ -0,0 +1,28 @@
+#version 450
+
+// corner of the unit quad, shared by every tile
+layout(location = 0) in vec2 corner;
+
+// per-instance tile data
+layout(location = 1) in uvec2 tile_pos;
+layout(location = 2) in uvec2 tile_info;
+
+layout(set = 1, binding = 0) uniform Camera {
+    vec2 pos;
+    vec2 scale;
+} camera;
+
+layout(push_constant) uniform Grid {
+    uvec2 atlas_size;
+} grid;
+
+layout(location = 0) out vec2 frag_uv;
+
+void main() {
+    uint tile = tile_info.x;
+    uvec2 cell = uvec2(tile % grid.atlas_size.x, tile / grid.atlas_size.x);
+    vec2 world = vec2(tile_pos) + corner;
+
+    gl_Position = vec4((world - camera.pos) * camera.scale - 1.0, 0.0, 1.0);
+    frag_uv = (vec2(cell) + corner) / vec2(grid.atlas_size);
+}
@@ -1,9 +1,15 @@
+#define _POSIX_C_SOURCE 199309L
+
 #include <stdarg.h>
 #include <stdatomic.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <stdnoreturn.h>
 #include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include "utils.h"
 
@@ -105,6 +111,15 @@ void *vmalloc(usize size) {
     return data;
 }
 
+void *vcalloc(usize size) {
+    void *data = calloc(1, size);
+
+    if (data == NULL)
+        panic("failed to allocate 0x%x bytes", size);
+
+    return data;
+}
+
 void *vrealloc(void *ptr, usize size) {
     void *data = realloc(ptr, size);
 
@@ -114,21 +129,100 @@ void *vrealloc(void *ptr, usize size) {
     return data;
 }
 
+/* Runtime counterpart to `HASH`, producing the same value for strings the
+ * macro accepts. Like the macro only the last 256 characters are hashed. */
+u32 hash(const char *str) {
+    usize len = strlen(str);
+
+    if (len > 256) {
+        str += len - 256;
+        len = 256;
+    }
+
+    return hash_bytes(str, len);
+}
+
+/* Runtime counterpart to `HASH` for arbitrary bytes. */
+u32 hash_bytes(const void *data, usize size) {
+    const u8 *bytes = data;
+    u32 x = 0;
+
+    for (usize idx = 0; idx < size; idx++)
+        x = x * 65599u + bytes[idx];
+
+    return x ^ (x >> 16);
+}
+
 // Force `val` to be between `min` and `max`.
 u32 clamp(u32 val, u32 min, u32 max) {
     return val < min ? min : max;
 }
 
+/* Reads a clock that only moves forward, including while the process is
+ * blocked or asleep. */
 void now(struct timespec *time) {
 
-#ifdef __linux__
-    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, time);
+#if defined(__linux__) || defined(__APPLE__)
+    clock_gettime(CLOCK_MONOTONIC, time);
 #else
     timespec_get(time, TIME_UTC);
 #endif
 
 }
 
+/* Nanoseconds on the clock used by `now`. */
+u64 now_ns() {
+    struct timespec time;
+
+    now(&time);
+    return (u64)time.tv_sec * 1000000000 + (u64)time.tv_nsec;
+}
+
+/* Sleeping stops this long before a deadline and the remainder is spun on,
+ * as the scheduler can oversleep by about a millisecond */
+#define PACER_SPIN_NS 1500000
+
+/* Paces frames to `fps` frames a second, 0 disables pacing. */
+void pacer_init(FramePacer *pacer, u32 fps) {
+    pacer->period = fps ? 1000000000 / fps : 0;
+    pacer->deadline = now_ns() + pacer->period;
+}
+
+/* Waits for the next frame's deadline.
+ *
+ * Deadlines are a fixed period apart so short and long frames average out,
+ * but a frame that ran more than a whole period late resets the schedule
+ * instead of rushing the following frames to catch up. */
+void pacer_wait(FramePacer *pacer) {
+    u64 time = now_ns();
+
+    if (pacer->period == 0)
+        return;
+
+    if (time >= pacer->deadline) {
+        if (time - pacer->deadline > pacer->period)
+            pacer->deadline = time;
+
+        pacer->deadline += pacer->period;
+        return;
+    }
+
+    if (pacer->deadline - time > PACER_SPIN_NS) {
+        u64 sleep = pacer->deadline - time - PACER_SPIN_NS;
+        struct timespec duration = {
+            .tv_sec = sleep / 1000000000,
+            .tv_nsec = sleep % 1000000000,
+        };
+
+        nanosleep(&duration, NULL);
+    }
+
+    while (now_ns() < pacer->deadline)
+        ;
+
+    pacer->deadline += pacer->period;
+}
+
 /* Calculates the numbers of seconds elapseds since some starting point */
 f64 time_elapsed(struct timespec *start) {
     struct timespec diff, time;
@@ -171,3 +265,50 @@ char *read_binary(const char *path, u32 *bytes_read) {
 
     return bytes;
 }
+
+/* Maps a whole file into memory read-only, falling back to reading it with
+ * `read_binary`. Pages of a mapped file are only read from disk once
+ * they're touched. */
+bool file_map(const char *path, MappedFile *file) {
+    struct stat info;
+    void *data;
+    u32 bytes_read;
+    int fd;
+
+    if ((fd = open(path, O_RDONLY)) == -1)
+        return false;
+
+    if (fstat(fd, &info) == -1) {
+        close(fd);
+        return false;
+    }
+
+    file->size = info.st_size;
+    data = mmap(NULL, file->size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (data != MAP_FAILED) {
+        file->data = data;
+        file->mapped = true;
+        return true;
+    }
+
+    if (!(data = read_binary(path, &bytes_read)))
+        return false;
+
+    file->data = data;
+    file->size = bytes_read;
+    file->mapped = false;
+    return true;
+}
+
+void file_unmap(MappedFile *file) {
+    if (file->data && file->mapped)
+        munmap((void *)file->data, file->size);
+    else
+        free((void *)file->data);
+
+    file->data = NULL;
+    file->size = 0;
+    file->mapped = false;
+}
@@ -50,20 +50,6 @@ const char **get_optional_extensions(u32 *count) {
     return extensions_names;
 }
 
-u32 vk_find_memory_type(RenderContext *ctx, VkMemoryRequirements reqs,
-                        VkMemoryPropertyFlags flags) {
-
-    for (u32 idx = 0; idx < ctx->mem_prop.memoryTypeCount; idx++) {
-        if ((reqs.memoryTypeBits & (1 << idx)) &&
-            ctx->mem_prop.memoryTypes[idx].propertyFlags & flags) {
-            return idx;
-        }
-    }
-
-    warn("failed to find any compatible memory type");
-    return 0;
-}
-
 bool matches_device_requirements(VkPhysicalDevice device) {
     u32 count, idx;
     VkPhysicalDeviceFeatures features;
@@ -105,6 +91,25 @@ bool matches_device_requirements(VkPhysicalDevice device) {
     return features.geometryShader && features.samplerAnisotropy;
 }
 
+const char *present_mode_name(VkPresentModeKHR present_mode) {
+    switch (present_mode) {
+    case VK_PRESENT_MODE_IMMEDIATE_KHR:
+        return "VK_PRESENT_MODE_IMMEDIATE_KHR";
+    case VK_PRESENT_MODE_MAILBOX_KHR:
+        return "VK_PRESENT_MODE_MAILBOX_KHR";
+    case VK_PRESENT_MODE_FIFO_KHR:
+        return "VK_PRESENT_MODE_FIFO_KHR";
+    case VK_PRESENT_MODE_FIFO_RELAXED_KHR:
+        return "VK_PRESENT_MODE_FIFO_RELAXED_KHR";
+    case VK_PRESENT_MODE_SHARED_DEMAND_REFRESH_KHR:
+        return "VK_PRESENT_MODE_SHARED_DEMAND_REFRESH_KHR";
+    case VK_PRESENT_MODE_SHARED_CONTINUOUS_REFRESH_KHR:
+        return "VK_PRESENT_MODE_SHARED_CONTINUOUS_REFRESH_KHR";
+    default:
+        return "VK_PRESENT_MODE_MAX_ENUM_KHR";
+    }
+}
+
 // Sets correct present mode on success. In the case of failing to find the
 // preferred present mode, the present mode is left untouched.
 bool try_preferred_present_mode(RenderContext *ctx,
@@ -116,7 +121,7 @@ bool try_preferred_present_mode(RenderContext *ctx,
     present_support_result = vkGetPhysicalDeviceSurfacePresentModesKHR(
         ctx->device, ctx->surface, &count, NULL);
 
-    present_modes = vmalloc(count * sizeof(VkPresentModeKHR *));
+    present_modes = vmalloc(count * sizeof(VkPresentModeKHR));
     present_support_result = vkGetPhysicalDeviceSurfacePresentModesKHR(
         ctx->device, ctx->surface, &count, present_modes);
 
@@ -128,31 +133,8 @@ bool try_preferred_present_mode(RenderContext *ctx,
     if (get_log_level() == LOG_TRACE) {
         const char **names = vmalloc(count * sizeof(char *));
 
-        for (idx = 0; idx < count; idx++) {
-            switch (present_modes[idx]) {
-            case VK_PRESENT_MODE_IMMEDIATE_KHR:
-                names[idx] = "VK_PRESENT_MODE_IMMEDIATE_KHR";
-                break;
-            case VK_PRESENT_MODE_MAILBOX_KHR:
-                names[idx] = "VK_PRESENT_MODE_MAILBOX_KHR";
-                break;
-            case VK_PRESENT_MODE_FIFO_KHR:
-                names[idx] = "VK_PRESENT_MODE_FIFO_KHR";
-                break;
-            case VK_PRESENT_MODE_FIFO_RELAXED_KHR:
-                names[idx] = "VK_PRESENT_MODE_FIFO_RELAXED_KHR";
-                break;
-            case VK_PRESENT_MODE_SHARED_DEMAND_REFRESH_KHR:
-                names[idx] = "VK_PRESENT_MODE_SHARED_DEMAND_REFRESH_KHR";
-                break;
-            case VK_PRESENT_MODE_SHARED_CONTINUOUS_REFRESH_KHR:
-                names[idx] = "VK_PRESENT_MODE_SHARED_CONTINUOUS_REFRESH_KHR";
-                break;
-            case VK_PRESENT_MODE_MAX_ENUM_KHR:
-                names[idx] = "VK_PRESENT_MODE_MAX_ENUM_KHR";
-                break;
-            }
-        }
+        for (idx = 0; idx < count; idx++)
+            names[idx] = present_mode_name(present_modes[idx]);
 
         trace_array(names, count, "supported present modes: ");
         free(names);
@@ -190,10 +172,16 @@ bool try_preferred_swapchain_format(RenderContext *ctx) {
     return false;
 }
 
-/* Try to find a queue family that supports graphics. */
+/* Try to find a queue family that supports graphics.
+ *
+ * Uploads prefer a family that only supports transfers, which usually maps
+ * to the GPU's DMA engines, then any family without graphics support, and
+ * fall back to the graphics family otherwise. */
 bool find_queue_families(RenderContext *ctx) {
     u32 count;
     VkQueueFamilyProperties *families;
+    bool graphics_found = false;
+    u32 transfer_score = 0;
 
     vkGetPhysicalDeviceQueueFamilyProperties(ctx->device, &count, NULL);
     families = vmalloc(count * sizeof(VkQueueFamilyProperties));
@@ -202,14 +190,30 @@ bool find_queue_families(RenderContext *ctx) {
     for (u32 idx = 0; idx < count; idx++) {
         if (families[idx].queueFlags & VK_QUEUE_GRAPHICS_BIT) {
             ctx->queue_family = idx;
+            graphics_found = true;
+            break;
+        }
+    }
 
-            free(families);
-            return true;
+    ctx->transfer_family = ctx->queue_family;
+
+    for (u32 idx = 0; idx < count; idx++) {
+        VkQueueFlags flags = families[idx].queueFlags;
+        u32 score;
+
+        if (!(flags & VK_QUEUE_TRANSFER_BIT) || (flags & VK_QUEUE_GRAPHICS_BIT))
+            continue;
+
+        score = (flags & VK_QUEUE_COMPUTE_BIT) ? 1 : 2;
+
+        if (score > transfer_score) {
+            ctx->transfer_family = idx;
+            transfer_score = score;
         }
     }
 
     free(families);
-    return false;
+    return graphics_found;
 }
 
 /* Retrieve the names of all available layers. */
@@ -441,7 +445,7 @@ bool vk_swapchain_create(RenderContext *ctx) {
         .imageArrayLayers = 1,
         .imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
         .compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR,
-        .presentMode = VK_PRESENT_MODE_MAILBOX_KHR,
+        .presentMode = ctx->present_mode,
         .clipped = VK_TRUE,
         .oldSwapchain = VK_NULL_HANDLE,
     };
@@ -457,8 +461,21 @@ bool vk_swapchain_create(RenderContext *ctx) {
 
     create_info.preTransform = capabilities->currentTransform;
 
-    // number of images to be held in the swapchain
-    chain->image_count = capabilities->minImageCount + 2;
+    // number of images to be held in the swapchain, one more than the
+    // minimum unless asked for otherwise
+    if (ctx->swapchain_images)
+        chain->image_count = ctx->swapchain_images;
+    else
+        chain->image_count = capabilities->minImageCount + 1;
+
+    if (chain->image_count < capabilities->minImageCount)
+        chain->image_count = capabilities->minImageCount;
+
+    // a maximum of 0 means there's no limit
+    if (capabilities->maxImageCount != 0 &&
+        chain->image_count > capabilities->maxImageCount)
+        chain->image_count = capabilities->maxImageCount;
+
     create_info.minImageCount = chain->image_count;
 
     vk_fail = vkGetPhysicalDeviceSurfaceFormatsKHR(
@@ -489,8 +506,21 @@ bool vk_swapchain_create(RenderContext *ctx) {
 
     create_info.imageFormat = ctx->surface_format.format;
 
-    if (!try_preferred_present_mode(ctx, &create_info.presentMode))
-        create_info.presentMode = VK_PRESENT_MODE_MAILBOX_KHR;
+    // FIFO is the only present mode every device has to support
+    if (!try_preferred_present_mode(ctx, &create_info.presentMode)) {
+        warn(
+            "%s isn't supported, falling back to VK_PRESENT_MODE_FIFO_KHR",
+            present_mode_name(create_info.presentMode)
+        );
+
+        create_info.presentMode = VK_PRESENT_MODE_FIFO_KHR;
+    }
+
+    info(
+        "presenting with %s and at least %d swapchain images",
+        present_mode_name(create_info.presentMode),
+        chain->image_count
+    );
 
     vk_swapchain_present_create(ctx);
     create_info.imageExtent = ctx->dimensions;
@@ -544,6 +574,21 @@ void vk_swapchain_destroy(RenderContext *ctx) {
     free(chain->views);
 }
 
+/* Covers the whole swapchain with the viewport and scissor set by every
+ * secondary command buffer. */
+void vk_viewport_update(RenderContext *ctx) {
+    ctx->viewport.x = 0.0;
+    ctx->viewport.y = 0.0;
+    ctx->viewport.width = (f32)ctx->dimensions.width;
+    ctx->viewport.height = (f32)ctx->dimensions.height;
+    ctx->viewport.minDepth = 0.0;
+    ctx->viewport.maxDepth = 1.0;
+
+    ctx->scissor.offset.x = 0;
+    ctx->scissor.offset.y = 0;
+    ctx->scissor.extent = ctx->dimensions;
+}
+
 bool vk_swapchain_recreate(RenderContext *ctx) {
     vkDeviceWaitIdle(ctx->driver);
 
@@ -558,9 +603,68 @@ bool vk_swapchain_recreate(RenderContext *ctx) {
     if (!vk_framebuffers_create(ctx))
         return false;
 
+    // the viewport and scissor follow the new size, the static layers still
+    // have the old ones baked in
+    vk_viewport_update(ctx);
+    vk_static_layers_invalidate(ctx);
+
     return true;
 }
 
+/* Checks whether the device can index a runtime sized texture array that
+ * is updated while bound, and sizes the array to the device's limits. */
+bool vk_bindless_supported(RenderContext *ctx, VkPhysicalDeviceFeatures2 *features) {
+    VkPhysicalDeviceVulkan12Features *indexing = features->pNext;
+
+    VkPhysicalDeviceDescriptorIndexingProperties indexing_prop = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES,
+    };
+
+    VkPhysicalDeviceProperties2 prop = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2,
+        .pNext = &indexing_prop,
+    };
+
+    // descriptor indexing features are only core since Vulkan 1.2
+    if (ctx->dev_prop.apiVersion < VK_API_VERSION_1_2)
+        return false;
+
+    vkGetPhysicalDeviceFeatures2(ctx->device, features);
+
+    if (!indexing->runtimeDescriptorArray ||
+        !indexing->descriptorBindingPartiallyBound ||
+        !indexing->descriptorBindingSampledImageUpdateAfterBind ||
+        !indexing->descriptorBindingUpdateUnusedWhilePending ||
+        !indexing->shaderSampledImageArrayNonUniformIndexing)
+        return false;
+
+    vkGetPhysicalDeviceProperties2(ctx->device, &prop);
+
+    ctx->bindless_capacity = BINDLESS_TEXTURE_COUNT;
+
+    if (indexing_prop.maxDescriptorSetUpdateAfterBindSampledImages < ctx->bindless_capacity)
+        ctx->bindless_capacity = indexing_prop.maxDescriptorSetUpdateAfterBindSampledImages;
+
+    if (indexing_prop.maxPerStageDescriptorUpdateAfterBindSampledImages < ctx->bindless_capacity)
+        ctx->bindless_capacity = indexing_prop.maxPerStageDescriptorUpdateAfterBindSampledImages;
+
+    // combined image samplers count as a sampler as well as a sampled image
+    if (indexing_prop.maxDescriptorSetUpdateAfterBindSamplers < ctx->bindless_capacity)
+        ctx->bindless_capacity = indexing_prop.maxDescriptorSetUpdateAfterBindSamplers;
+
+    if (indexing_prop.maxPerStageDescriptorUpdateAfterBindSamplers < ctx->bindless_capacity)
+        ctx->bindless_capacity = indexing_prop.maxPerStageDescriptorUpdateAfterBindSamplers;
+
+    // the fragment stage also writes the color attachment, which counts
+    // against its resources. The camera is only read by the vertex stage
+    if (indexing_prop.maxPerStageUpdateAfterBindResources < ctx->bindless_capacity + 1)
+        ctx->bindless_capacity = indexing_prop.maxPerStageUpdateAfterBindResources > 0
+            ? indexing_prop.maxPerStageUpdateAfterBindResources - 1
+            : 0;
+
+    return ctx->bindless_capacity > 0;
+}
+
 // NOTE: can create multiple logical devices with different requirements
 // for the same physical device
 
@@ -575,6 +679,15 @@ bool vk_device_create(RenderContext *ctx) {
         .samplerAnisotropy = VK_TRUE
     };
 
+    VkPhysicalDeviceVulkan12Features indexing_features = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_12_FEATURES,
+    };
+
+    VkPhysicalDeviceFeatures2 features = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+        .pNext = &indexing_features,
+    };
+
     VkDeviceCreateInfo device_create_info = {
         .sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
         .queueCreateInfoCount = 1,
@@ -583,20 +696,50 @@ bool vk_device_create(RenderContext *ctx) {
         .ppEnabledExtensionNames = device_extensions,
     };
 
-    VkDeviceQueueCreateInfo queue_create_info = {
-        .sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
-        .queueCount = 1,
-        .pQueuePriorities = &queue_priority,
+    VkDeviceQueueCreateInfo queue_create_infos[2] = {
+        {
+            .sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
+            .queueCount = 1,
+            .pQueuePriorities = &queue_priority,
+        },
+        {
+            .sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
+            .queueCount = 1,
+            .pQueuePriorities = &queue_priority,
+        }
     };
 
-    // find a simple queue that can handle at least graphics for now
+    // find a queue that can handle graphics and one for uploads
     if (!find_queue_families(ctx)) {
         warn("couldn't find any queue families");
         return false;
     }
 
-    queue_create_info.queueFamilyIndex = ctx->queue_family;
-    device_create_info.pQueueCreateInfos = &queue_create_info;
+    queue_create_infos[0].queueFamilyIndex = ctx->queue_family;
+    queue_create_infos[1].queueFamilyIndex = ctx->transfer_family;
+    device_create_info.pQueueCreateInfos = queue_create_infos;
+
+    if (ctx->transfer_family != ctx->queue_family)
+        device_create_info.queueCreateInfoCount = 2;
+
+    if (ctx->bindless && !vk_bindless_supported(ctx, &features)) {
+        warn("descriptor indexing unsupported, falling back to descriptor sets");
+        ctx->bindless = false;
+    }
+
+    if (ctx->bindless) {
+        // only enable the features bindless textures rely on
+        indexing_features = (VkPhysicalDeviceVulkan12Features) {
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_12_FEATURES,
+            .runtimeDescriptorArray = VK_TRUE,
+            .descriptorBindingPartiallyBound = VK_TRUE,
+            .descriptorBindingSampledImageUpdateAfterBind = VK_TRUE,
+            .descriptorBindingUpdateUnusedWhilePending = VK_TRUE,
+            .shaderSampledImageArrayNonUniformIndexing = VK_TRUE,
+        };
+
+        device_create_info.pNext = &indexing_features;
+    }
 
     if (vkCreateDevice(ctx->device, &device_create_info, NULL, &ctx->driver)) {
         warn("failed to create driver");
@@ -604,6 +747,15 @@ bool vk_device_create(RenderContext *ctx) {
     }
 
     vkGetDeviceQueue(ctx->driver, ctx->queue_family, 0, &ctx->queue);
+    vkGetDeviceQueue(
+        ctx->driver,
+        ctx->transfer_family,
+        0,
+        &ctx->transfer_queue
+    );
+
+    if (ctx->transfer_family != ctx->queue_family)
+        info("uploading through transfer queue family %d", ctx->transfer_family);
 
     if (!SDL_Vulkan_CreateSurface(ctx->window, ctx->instance, &ctx->surface)) {
         warn("failed to create surface");
@@ -843,58 +995,32 @@ bool vk_render_pass_create(RenderContext *ctx) {
 // it's possible to break up lines and triangles in the _STRIP topology
 // modes by using a special index of 0xFFFF or 0xFFFFFFFF.
 
-bool vk_pipeline_create(RenderContext *ctx) {
-    u32 vert_size, frag_size;
-    char *vert_bin;
-    char *frag_bin;
-    bool success = true;
-
-    VkPipelineShaderStageCreateInfo vert_shader_info = {
-        .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
-        .stage = VK_SHADER_STAGE_VERTEX_BIT,
-        .pName = "main"
-    };
-
-    VkPipelineShaderStageCreateInfo frag_shader_info = {
-        .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
-        .stage = VK_SHADER_STAGE_FRAGMENT_BIT,
-        .pName = "main"
-    };
-
-    VkPipelineShaderStageCreateInfo shader_stages[2];
-
-    VkPipelineDynamicStateCreateInfo dynamic_create_info = {
-        .sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO,
-    };
-
-    VkVertexInputBindingDescription binding_desc = {
-        .binding = 0,
-        .stride = sizeof(Vertex),
-        .inputRate = VK_VERTEX_INPUT_RATE_VERTEX
-    };
+/* Creates a graphics pipeline using the fixed function state shared by
+ * every pipeline, only the vertex stage and it's inputs differ. */
+bool vk_pipeline_variant_create(RenderContext *ctx,
+                                VkShaderModule vert,
+                                VkPipelineVertexInputStateCreateInfo *input,
+                                VkPipeline *pipeline) {
 
-    VkVertexInputAttributeDescription vert_attr_descs[2] = {
+    VkPipelineShaderStageCreateInfo shader_stages[2] = {
         {
-            .binding = 0,
-            .location = 0,
-            .format = VK_FORMAT_R32G32_SFLOAT,
-            .offset = offsetof(Vertex, pos)
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+            .stage = VK_SHADER_STAGE_VERTEX_BIT,
+            .module = vert,
+            .pName = "main"
         },
         {
-            .binding = 0,
-            .location = 1,
-            .format = VK_FORMAT_R32G32_SFLOAT,
-            .offset = offsetof(Vertex, tex)
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+            .stage = VK_SHADER_STAGE_FRAGMENT_BIT,
+            .module = ctx->frag,
+            .pName = "main"
         }
     };
 
-    // TODO: `pVertexBindingDescriptions` and `pVertexAttributeDescriptions`
-    VkPipelineVertexInputStateCreateInfo vertex_input_info = {
-        .sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
-        .vertexBindingDescriptionCount = 1,
-        .pVertexBindingDescriptions = &binding_desc,
-        .vertexAttributeDescriptionCount = 2,
-        .pVertexAttributeDescriptions = vert_attr_descs
+    VkPipelineDynamicStateCreateInfo dynamic_create_info = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO,
+        .dynamicStateCount = ctx->dynamic_state_count,
+        .pDynamicStates = ctx->dynamic_states,
     };
 
     VkPipelineInputAssemblyStateCreateInfo input_assembly_info = {
@@ -906,7 +1032,9 @@ bool vk_pipeline_create(RenderContext *ctx) {
     VkPipelineViewportStateCreateInfo viewport_info = {
         .sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO,
         .viewportCount = 1,
+        .pViewports = &ctx->viewport,
         .scissorCount = 1,
+        .pScissors = &ctx->scissor,
     };
 
     // `polygonMode` can be used with `VK_POLYGON_MODE_LINE` for wireframe
@@ -943,12 +1071,6 @@ bool vk_pipeline_create(RenderContext *ctx) {
         .pAttachments = &color_blend_attachment
     };
 
-    VkPipelineLayoutCreateInfo pipeline_layout_info = {
-        .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
-        .setLayoutCount = 1,
-        .pSetLayouts = &ctx->desc_set_layout,
-    };
-
     VkGraphicsPipelineCreateInfo pipeline_info = {
         .sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
         .renderPass = ctx->render_pass,
@@ -956,7 +1078,8 @@ bool vk_pipeline_create(RenderContext *ctx) {
         .basePipelineHandle = NULL, // other potential pipeline to use for faster creation
         .basePipelineIndex = -1, // of pipelines that share functionality
         .stageCount = 2,
-        .pVertexInputState = &vertex_input_info,
+        .pStages = shader_stages,
+        .pVertexInputState = input,
         .pInputAssemblyState = &input_assembly_info,
         .pViewportState = &viewport_info,
         .pRasterizationState = &rasterizer_info,
@@ -964,20 +1087,158 @@ bool vk_pipeline_create(RenderContext *ctx) {
         .pColorBlendState = &color_blend_info,
         .pDynamicState = &dynamic_create_info,
         .pDepthStencilState = NULL,
+        .layout = ctx->pipeline_layout,
+    };
+
+    // `vkCreateGraphicsPipelines` takes a list of pipelines to create at once
+    return vkCreateGraphicsPipelines(
+        ctx->driver,
+        NULL,
+        1,
+        &pipeline_info,
+        NULL,
+        pipeline
+    ) == VK_SUCCESS;
+}
+
+/* Creates the pipeline for objects and it's instanced variant for tiles.
+ *
+ * Objects have their vertices computed on the CPU. Tiles share a single unit
+ * quad that `tile.vert` positions using a per-instance `TileInstance`. */
+bool vk_pipeline_create(RenderContext *ctx) {
+    u32 vert_size, tile_vert_size, frag_size;
+    char *vert_bin;
+    char *tile_vert_bin;
+    char *frag_bin;
+    bool success = true;
+
+    VkVertexInputBindingDescription binding_desc = {
+        .binding = 0,
+        .stride = sizeof(Vertex),
+        .inputRate = VK_VERTEX_INPUT_RATE_VERTEX
+    };
+
+    VkVertexInputAttributeDescription vert_attr_descs[2] = {
+        {
+            .binding = 0,
+            .location = 0,
+            .format = VK_FORMAT_R32G32_SFLOAT,
+            .offset = offsetof(Vertex, pos)
+        },
+        {
+            .binding = 0,
+            .location = 1,
+            .format = VK_FORMAT_R32G32_SFLOAT,
+            .offset = offsetof(Vertex, tex)
+        }
+    };
+
+    VkPipelineVertexInputStateCreateInfo vertex_input_info = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
+        .vertexBindingDescriptionCount = 1,
+        .pVertexBindingDescriptions = &binding_desc,
+        .vertexAttributeDescriptionCount = 2,
+        .pVertexAttributeDescriptions = vert_attr_descs
+    };
+
+    // binding 0 is the unit quad, binding 1 advances once per tile
+    VkVertexInputBindingDescription tile_binding_descs[2] = {
+        {
+            .binding = 0,
+            .stride = sizeof(Vertex),
+            .inputRate = VK_VERTEX_INPUT_RATE_VERTEX
+        },
+        {
+            .binding = 1,
+            .stride = sizeof(TileInstance),
+            .inputRate = VK_VERTEX_INPUT_RATE_INSTANCE
+        }
+    };
+
+    VkVertexInputAttributeDescription tile_attr_descs[3] = {
+        {
+            .binding = 0,
+            .location = 0,
+            .format = VK_FORMAT_R32G32_SFLOAT,
+            .offset = offsetof(Vertex, pos)
+        },
+        {
+            .binding = 1,
+            .location = 1,
+            .format = VK_FORMAT_R16G16_UINT,
+            .offset = offsetof(TileInstance, pos)
+        },
+        {
+            .binding = 1,
+            .location = 2,
+            .format = VK_FORMAT_R16G16_UINT,
+            .offset = offsetof(TileInstance, tile)
+        }
+    };
+
+    VkPipelineVertexInputStateCreateInfo tile_input_info = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
+        .vertexBindingDescriptionCount = 2,
+        .pVertexBindingDescriptions = tile_binding_descs,
+        .vertexAttributeDescriptionCount = 3,
+        .pVertexAttributeDescriptions = tile_attr_descs
+    };
+
+    // the fragment range only carries the texture index in bindless mode
+    VkPushConstantRange push_constant_ranges[2] = {
+        {
+            .stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
+            .offset = 0,
+            .size = sizeof(TileGrid)
+        },
+        {
+            .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
+            .offset = sizeof(TileGrid),
+            .size = sizeof(DrawConstants)
+        }
+    };
+
+    // textures are in set 0 and the camera in set 1
+    VkDescriptorSetLayout set_layouts[2] = {
+        ctx->desc_set_layout,
+        ctx->camera_layout
+    };
+
+    VkPipelineLayoutCreateInfo pipeline_layout_info = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+        .setLayoutCount = 2,
+        .pSetLayouts = set_layouts,
+        .pushConstantRangeCount = ctx->bindless ? 2 : 1,
+        .pPushConstantRanges = push_constant_ranges,
     };
 
     vert_bin = read_binary("./target/shader.vert.spv", &vert_size);
-    frag_bin = read_binary("./target/shader.frag.spv", &frag_size);
+    tile_vert_bin = read_binary("./target/tile.vert.spv", &tile_vert_size);
 
-    if (!vert_bin || !frag_bin) {
+    if (ctx->bindless)
+        frag_bin = read_binary("./target/bindless.frag.spv", &frag_size);
+    else
+        frag_bin = read_binary("./target/shader.frag.spv", &frag_size);
+
+    if (!vert_bin || !tile_vert_bin || !frag_bin) {
         error("failed to read shader source");
+        free(vert_bin);
+        free(tile_vert_bin);
+        free(frag_bin);
         return false;
     }
 
-    success |= vk_shader_module_create(ctx, frag_bin, frag_size, &ctx->frag);
-    success |= vk_shader_module_create(ctx, vert_bin, vert_size, &ctx->vert);
+    success &= vk_shader_module_create(ctx, frag_bin, frag_size, &ctx->frag);
+    success &= vk_shader_module_create(ctx, vert_bin, vert_size, &ctx->vert);
+    success &= vk_shader_module_create(
+        ctx,
+        tile_vert_bin,
+        tile_vert_size,
+        &ctx->tile_vert
+    );
 
     free(vert_bin);
+    free(tile_vert_bin);
     free(frag_bin);
 
     if (!success) {
@@ -985,33 +1246,13 @@ bool vk_pipeline_create(RenderContext *ctx) {
         return false;
     }
 
-    vert_shader_info.module = ctx->vert;
-    frag_shader_info.module = ctx->frag;
-
-    shader_stages[0] = vert_shader_info;
-    shader_stages[1] = frag_shader_info;
-    pipeline_info.pStages = shader_stages;
-
     ctx->dynamic_states = vmalloc(2 * sizeof(VkDynamicState));
     ctx->dynamic_state_count = 2;
-    dynamic_create_info.dynamicStateCount = ctx->dynamic_state_count;
 
     ctx->dynamic_states[0] = VK_DYNAMIC_STATE_VIEWPORT;
     ctx->dynamic_states[1] = VK_DYNAMIC_STATE_SCISSOR;
-    dynamic_create_info.pDynamicStates = ctx->dynamic_states;
-
-    ctx->viewport.x = 0.0;
-    ctx->viewport.y = 0.0;
-    ctx->viewport.width = (f32)ctx->dimensions.width;
-    ctx->viewport.height = (f32)ctx->dimensions.height;
-    ctx->viewport.minDepth = 0.0;
-    ctx->viewport.maxDepth = 1.0;
-    viewport_info.pViewports = &ctx->viewport;
 
-    ctx->scissor.offset.x = 0;
-    ctx->scissor.offset.y = 0;
-    ctx->scissor.extent = ctx->dimensions;
-    viewport_info.pScissors = &ctx->scissor;
+    vk_viewport_update(ctx);
 
     success = vkCreatePipelineLayout(
         ctx->driver,
@@ -1025,23 +1266,27 @@ bool vk_pipeline_create(RenderContext *ctx) {
         return false;
     }
 
-    pipeline_info.layout = ctx->pipeline_layout;
+    if (!vk_pipeline_variant_create(ctx, ctx->vert, &vertex_input_info,
+                                    &ctx->pipeline)) {
+        error("failed to create object pipeline");
+        return false;
+    }
 
-    // `vkCreateGraphicsPipelines` takes a list of pipelines to create at once
-    return vkCreateGraphicsPipelines(
-        ctx->driver,
-        NULL,
-        1,
-        &pipeline_info,
-        NULL,
-        &ctx->pipeline
-    ) == VK_SUCCESS;
+    if (!vk_pipeline_variant_create(ctx, ctx->tile_vert, &tile_input_info,
+                                    &ctx->tile_pipeline)) {
+        error("failed to create instanced tile pipeline");
+        return false;
+    }
+
+    return true;
 }
 
 void vk_pipeline_destroy(RenderContext *ctx) {
     vkDestroyPipeline(ctx->driver, ctx->pipeline, NULL);
+    vkDestroyPipeline(ctx->driver, ctx->tile_pipeline, NULL);
     vkDestroyPipelineLayout(ctx->driver, ctx->pipeline_layout, NULL);
     vkDestroyShaderModule(ctx->driver, ctx->vert, NULL);
+    vkDestroyShaderModule(ctx->driver, ctx->tile_vert, NULL);
     vkDestroyShaderModule(ctx->driver, ctx->frag, NULL);
 
     free(ctx->dynamic_states);
@@ -1055,6 +1300,19 @@ bool vk_descriptor_layouts_create(RenderContext *ctx) {
         .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT
     };
 
+    // slots of the array are filled in as textures get loaded, possibly
+    // while the set is used by frames in flight
+    VkDescriptorBindingFlags binding_flags =
+        VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT |
+        VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT |
+        VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT;
+
+    VkDescriptorSetLayoutBindingFlagsCreateInfo binding_flags_info = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO,
+        .bindingCount = 1,
+        .pBindingFlags = &binding_flags,
+    };
+
     // can take multiply bindings
     VkDescriptorSetLayoutCreateInfo layout_info = {
         .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
@@ -1062,42 +1320,150 @@ bool vk_descriptor_layouts_create(RenderContext *ctx) {
         .pBindings = &sampler_layout_binding,
     };
 
+    VkDescriptorSetLayoutBinding camera_layout_binding = {
+        .binding = 0,
+        .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+        .descriptorCount = 1,
+        .stageFlags = VK_SHADER_STAGE_VERTEX_BIT
+    };
+
+    VkDescriptorSetLayoutCreateInfo camera_layout_info = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+        .bindingCount = 1,
+        .pBindings = &camera_layout_binding,
+    };
+
+    if (ctx->bindless) {
+        sampler_layout_binding.descriptorCount = ctx->bindless_capacity;
+        layout_info.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+        layout_info.pNext = &binding_flags_info;
+    }
+
+    if (vkCreateDescriptorSetLayout(ctx->driver, &layout_info, NULL,
+                                    &ctx->desc_set_layout))
+        return false;
+
     return vkCreateDescriptorSetLayout(
         ctx->driver,
-        &layout_info,
+        &camera_layout_info,
         NULL,
-        &ctx->desc_set_layout
+        &ctx->camera_layout
     ) == VK_SUCCESS;
 }
 
-#define DESC_POOL_SIZE 32 * 18 * 3 / 2
+/* Number of textures that can be alive at once.
+ *
+ * Tiles all share the atlas so this only has to cover the atlas and
+ * standalone objects such as the player and the menu. */
+#define DESC_POOL_SIZE 32
 
-bool vk_descriptor_pool_create(RenderContext *ctx) {
-    // pool big enough for a sampler
+/* Creates the single set every texture is written into in bindless mode. */
+bool vk_bindless_pool_create(RenderContext *ctx) {
     VkDescriptorPoolSize pool_size = {
         .type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-        .descriptorCount = MAX_FRAMES_LOADED
+        .descriptorCount = ctx->bindless_capacity
     };
 
     VkDescriptorPoolCreateInfo pool_info = {
         .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+        .flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT,
         .poolSizeCount = 1,
         .pPoolSizes = &pool_size,
-        .maxSets = MAX_FRAMES_LOADED * (DESC_POOL_SIZE + 1)
+        .maxSets = 1
     };
 
-    return vkCreateDescriptorPool(
-        ctx->driver,
-        &pool_info,
-        NULL,
-        &ctx->desc_pool
+    VkDescriptorSetAllocateInfo alloc_info = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+        .descriptorSetCount = 1,
+        .pSetLayouts = &ctx->desc_set_layout,
+    };
+
+    if (vkCreateDescriptorPool(ctx->driver, &pool_info, NULL, &ctx->desc_pool))
+        return false;
+
+    alloc_info.descriptorPool = ctx->desc_pool;
+
+    if (vkAllocateDescriptorSets(ctx->driver, &alloc_info, &ctx->bindless_set)) {
+        error("failed to allocate bindless descriptor set");
+        vkDestroyDescriptorPool(ctx->driver, ctx->desc_pool, NULL);
+        return false;
+    }
+
+    ctx->bindless_count = 0;
+    ctx->bindless_free_count = 0;
+    ctx->bindless_free = vmalloc(ctx->bindless_capacity * sizeof(u32));
+
+    info("bindless texture array of %d slots", ctx->bindless_capacity);
+
+    return true;
+}
+
+bool vk_descriptor_pool_create(RenderContext *ctx) {
+    if (ctx->bindless)
+        return vk_bindless_pool_create(ctx);
+
+    // pool big enough for a sampler per texture
+    VkDescriptorPoolSize pool_size = {
+        .type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+        .descriptorCount = ctx->frames_in_flight * (DESC_POOL_SIZE + 1)
+    };
+
+    // sets are freed individually when an object gets destroyed
+    VkDescriptorPoolCreateInfo pool_info = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+        .flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT,
+        .poolSizeCount = 1,
+        .pPoolSizes = &pool_size,
+        .maxSets = ctx->frames_in_flight * (DESC_POOL_SIZE + 1)
+    };
+
+    return vkCreateDescriptorPool(
+        ctx->driver,
+        &pool_info,
+        NULL,
+        &ctx->desc_pool
     ) == VK_SUCCESS;
 }
 
+/* Writes the texture into a free slot of the bindless texture array. */
+bool vk_bindless_texture_add(RenderContext *ctx, Texture *tex) {
+    VkDescriptorImageInfo image_info = {
+        .imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+        .sampler = tex->sampler,
+        .imageView = tex->view
+    };
+
+    VkWriteDescriptorSet desc_set = {
+        .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+        .dstSet = ctx->bindless_set,
+        .dstBinding = 0,
+        .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+        .descriptorCount = 1,
+        .pImageInfo = &image_info
+    };
+
+    if (ctx->bindless_free_count > 0) {
+        tex->index = ctx->bindless_free[--ctx->bindless_free_count];
+    } else if (ctx->bindless_count < ctx->bindless_capacity) {
+        tex->index = ctx->bindless_count++;
+    } else {
+        error("bindless texture array is full");
+        return false;
+    }
+
+    desc_set.dstArrayElement = tex->index;
+    vkUpdateDescriptorSets(ctx->driver, 1, &desc_set, 0, NULL);
+
+    return true;
+}
+
 bool vk_descriptor_sets_create(RenderContext *ctx, Texture *tex) {
     u32 idx;
     VkDescriptorSetLayout desc_set_layouts[MAX_FRAMES_LOADED];
 
+    if (ctx->bindless)
+        return vk_bindless_texture_add(ctx, tex);
+
     VkDescriptorSetAllocateInfo alloc_info = {
         .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
         .descriptorPool = ctx->desc_pool,
@@ -1119,19 +1485,23 @@ bool vk_descriptor_sets_create(RenderContext *ctx, Texture *tex) {
     };
 
     // copy the same descriptor set layout for each frame we render
-    for (idx = 0; idx < MAX_FRAMES_LOADED; idx++)
+    for (idx = 0; idx < ctx->frames_in_flight; idx++)
         desc_set_layouts[idx] = ctx->desc_set_layout;
 
     alloc_info.pSetLayouts = desc_set_layouts;
-    alloc_info.descriptorSetCount = MAX_FRAMES_LOADED;
+    alloc_info.descriptorSetCount = ctx->frames_in_flight;
+
+    tex->desc_sets = vmalloc(ctx->frames_in_flight * sizeof(VkDescriptorSet));
 
     if (vkAllocateDescriptorSets(ctx->driver, &alloc_info, tex->desc_sets)) {
         error("failed to allocate descriptor sets");
+        free(tex->desc_sets);
+        tex->desc_sets = NULL;
         return false;
     }
 
     // for every frame
-    for (idx = 0; idx < MAX_FRAMES_LOADED; idx++) {
+    for (idx = 0; idx < ctx->frames_in_flight; idx++) {
         desc_set.dstSet = tex->desc_sets[idx];
 
         // update the sampler
@@ -1147,11 +1517,6 @@ bool vk_descriptor_sets_create(RenderContext *ctx, Texture *tex) {
     return true;
 }
 
-void vk_descriptors_destroy(RenderContext *ctx) {
-    vkDestroyDescriptorPool(ctx->driver, ctx->desc_pool, NULL);
-    vkDestroyDescriptorSetLayout(ctx->driver, ctx->desc_set_layout, NULL);
-}
-
 bool vk_cmd_pool_create(RenderContext *ctx) {
     VkCommandPoolCreateInfo create_info = {
         .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
@@ -1169,13 +1534,14 @@ bool vk_cmd_pool_create(RenderContext *ctx) {
 
 bool vk_cmd_buffers_alloc(RenderContext *ctx,
                           VkCommandBuffer *cmd_bufs,
-                          u32 count) {
+                          u32 count,
+                          VkCommandBufferLevel level) {
 
     VkCommandBufferAllocateInfo alloc_info = {
         .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
         .commandPool = ctx->cmd_pool,
         .commandBufferCount = count,
-        .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+        .level = level,
     };
 
     return vkAllocateCommandBuffers(
@@ -1185,205 +1551,934 @@ bool vk_cmd_buffers_alloc(RenderContext *ctx,
     ) == VK_SUCCESS;
 }
 
-/// cmd_buf is the result of creating and beginning a command buffer
-bool vk_cmd_oneshot_start(RenderContext *ctx, VkCommandBuffer *cmd_buf) {
-    VkCommandBufferBeginInfo begin_info = {
-        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
-        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT
+bool vk_buffer_create(RenderContext *ctx, VkDeviceSize size,
+                      VkBufferUsageFlags usage,
+                      VkMemoryPropertyFlags flags,
+                      VkBuffer *buf, GpuAllocation *buf_mem) {
+
+    VkMemoryRequirements mem_reqs;
+
+    VkBufferCreateInfo buf_info = {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+        .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+        .size = size,
+        .usage = usage,
     };
 
-    if (!vk_cmd_buffers_alloc(ctx, cmd_buf, 1)) {
-        error("failed to allocate command buffer");
+    if (vkCreateBuffer(ctx->driver, &buf_info, NULL, buf))
+        return false;
+
+    vkGetBufferMemoryRequirements(ctx->driver, *buf, &mem_reqs);
+
+    if (!vk_memory_alloc(ctx, mem_reqs, flags, true, buf_mem)) {
+        vkDestroyBuffer(ctx->driver, *buf, NULL);
+        error("failed to allocate buffer memory");
         return false;
     }
 
-    if (vkBeginCommandBuffer(*cmd_buf, &begin_info)) {
-        error("failed to begin command buffer");
-        vkFreeCommandBuffers(ctx->driver, ctx->cmd_pool, 1, cmd_buf);
+    if (vkBindBufferMemory(ctx->driver, *buf, buf_mem->mem, buf_mem->offset)) {
+        error("failed to bind buffer memory");
+        vkDestroyBuffer(ctx->driver, *buf, NULL);
+        vk_memory_free(ctx, buf_mem);
         return false;
     }
 
     return true;
 }
 
-bool vk_cmd_oneshot_end(RenderContext *ctx, VkCommandBuffer cmd_buf) {
-    if (vkEndCommandBuffer(cmd_buf)) {
-        error("failed to end command buffer");
+/* Creates a copy of the camera for every frame in flight, each with a set
+ * pointing at it, so moving the camera never touches a frame the GPU is
+ * still drawing. */
+bool vk_camera_create(RenderContext *ctx) {
+    VkDeviceSize align = ctx->dev_prop.limits.minUniformBufferOffsetAlignment;
+    VkDescriptorSetLayout layouts[MAX_FRAMES_LOADED];
+    bool success;
+
+    VkDescriptorPoolSize pool_size = {
+        .type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+        .descriptorCount = ctx->frames_in_flight
+    };
+
+    VkDescriptorPoolCreateInfo pool_info = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+        .poolSizeCount = 1,
+        .pPoolSizes = &pool_size,
+        .maxSets = ctx->frames_in_flight
+    };
+
+    VkDescriptorSetAllocateInfo alloc_info = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+        .descriptorSetCount = ctx->frames_in_flight,
+        .pSetLayouts = layouts,
+    };
+
+    VkDescriptorBufferInfo buf_info = {
+        .range = sizeof(Camera)
+    };
+
+    VkWriteDescriptorSet desc_set = {
+        .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+        .dstBinding = 0,
+        .dstArrayElement = 0,
+        .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+        .descriptorCount = 1,
+        .pBufferInfo = &buf_info
+    };
+
+    // copies have to start at offsets the device can bind
+    if (align == 0)
+        align = 1;
+
+    ctx->camera_stride = (sizeof(Camera) + align - 1) / align * align;
+
+    success = vk_buffer_create(
+        ctx,
+        ctx->camera_stride * ctx->frames_in_flight,
+        VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+        VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+        &ctx->camera_buf,
+        &ctx->camera_mem
+    );
+
+    if (!success) {
+        error("failed to create camera buffer");
         return false;
     }
 
-    VkSubmitInfo submit_info = {
-        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
-        .pCommandBuffers = &cmd_buf,
+    if (vkCreateDescriptorPool(ctx->driver, &pool_info, NULL, &ctx->camera_pool))
+        return false;
+
+    for (u32 idx = 0; idx < ctx->frames_in_flight; idx++)
+        layouts[idx] = ctx->camera_layout;
+
+    alloc_info.descriptorPool = ctx->camera_pool;
+    ctx->camera_sets = vmalloc(ctx->frames_in_flight * sizeof(VkDescriptorSet));
+
+    if (vkAllocateDescriptorSets(ctx->driver, &alloc_info, ctx->camera_sets)) {
+        error("failed to allocate camera descriptor sets");
+        return false;
+    }
+
+    buf_info.buffer = ctx->camera_buf;
+
+    for (u32 idx = 0; idx < ctx->frames_in_flight; idx++) {
+        buf_info.offset = idx * ctx->camera_stride;
+        desc_set.dstSet = ctx->camera_sets[idx];
+
+        vkUpdateDescriptorSets(ctx->driver, 1, &desc_set, 0, NULL);
+    }
+
+    return true;
+}
+
+void vk_camera_destroy(RenderContext *ctx) {
+    vkDestroyDescriptorPool(ctx->driver, ctx->camera_pool, NULL);
+    vkDestroyBuffer(ctx->driver, ctx->camera_buf, NULL);
+    vk_memory_free(ctx, &ctx->camera_mem);
+    free(ctx->camera_sets);
+}
+
+bool vk_upload_context_create(RenderContext *ctx) {
+    UploadContext *upload = &ctx->upload;
+    bool success;
+
+    VkCommandPoolCreateInfo pool_info = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+        .flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT |
+                 VK_COMMAND_POOL_CREATE_TRANSIENT_BIT,
+        .queueFamilyIndex = ctx->transfer_family
+    };
+
+    VkCommandBufferAllocateInfo alloc_info = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
         .commandBufferCount = 1,
+        .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
     };
 
-    if (vkQueueSubmit(ctx->queue, 1, &submit_info, NULL)) {
-        error("failed to submit command buffer to queue");
+    VkFenceCreateInfo fence_info = {
+        .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
+    };
+
+    VkSemaphoreCreateInfo semaphore_info = {
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO
+    };
+
+    upload->uploads = NULL;
+    upload->upload_count = 0;
+    upload->upload_alloc_count = 0;
+    upload->batching = false;
+    upload->in_flight = false;
+    upload->semaphore_pending = false;
+    upload->buffer_acquires = NULL;
+    upload->buffer_acquire_count = 0;
+    upload->image_acquires = NULL;
+    upload->image_acquire_count = 0;
+    upload->staging.size = STAGING_RING_SIZE;
+    upload->staging.head = 0;
+    upload->staging.tail = 0;
+    upload->staging.submitted = 0;
+
+    success = vk_buffer_create(
+        ctx,
+        upload->staging.size,
+        VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+        VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+        &upload->staging.buf,
+        &upload->staging.mem
+    );
+
+    if (!success) {
+        error("failed to create staging ring");
+        return false;
+    }
+
+    if (vkCreateCommandPool(ctx->driver, &pool_info, NULL, &upload->cmd_pool)) {
+        error("failed to create upload command pool");
+        vkDestroyBuffer(ctx->driver, upload->staging.buf, NULL);
+        vk_memory_free(ctx, &upload->staging.mem);
         return false;
     }
 
-    if (vkQueueWaitIdle(ctx->queue)) {
-        error("failed to wait for queue");
+    alloc_info.commandPool = upload->cmd_pool;
+
+    if (vkAllocateCommandBuffers(ctx->driver, &alloc_info, &upload->cmd_buf)) {
+        error("failed to allocate upload command buffer");
+        vkDestroyCommandPool(ctx->driver, upload->cmd_pool, NULL);
+        vkDestroyBuffer(ctx->driver, upload->staging.buf, NULL);
+        vk_memory_free(ctx, &upload->staging.mem);
         return false;
     }
 
-    vkFreeCommandBuffers(ctx->driver, ctx->cmd_pool, 1, &cmd_buf);
+    if (vkCreateFence(ctx->driver, &fence_info, NULL, &upload->fence)) {
+        error("failed to create upload fence");
+        vkDestroyCommandPool(ctx->driver, upload->cmd_pool, NULL);
+        vkDestroyBuffer(ctx->driver, upload->staging.buf, NULL);
+        vk_memory_free(ctx, &upload->staging.mem);
+        return false;
+    }
+
+    if (vkCreateSemaphore(ctx->driver, &semaphore_info, NULL, &upload->semaphore)) {
+        error("failed to create upload semaphore");
+        vkDestroyFence(ctx->driver, upload->fence, NULL);
+        vkDestroyCommandPool(ctx->driver, upload->cmd_pool, NULL);
+        vkDestroyBuffer(ctx->driver, upload->staging.buf, NULL);
+        vk_memory_free(ctx, &upload->staging.mem);
+        return false;
+    }
 
     return true;
 }
 
-bool vk_buffer_copy(RenderContext *ctx, VkBuffer dst, VkBuffer src,
-                    VkDeviceSize size) {
+/* Waits for a batch in flight to complete and releases the staging buffers
+ * owned by its transfers. */
+bool vk_upload_wait(RenderContext *ctx) {
+    UploadContext *upload = &ctx->upload;
+    bool success = true;
+
+    if (!upload->in_flight)
+        return true;
+
+    if (vkWaitForFences(ctx->driver, 1, &upload->fence, VK_TRUE, UINT64_MAX)) {
+        error("failed to wait for uploads");
+        success = false;
+    }
+
+    vkResetFences(ctx->driver, 1, &upload->fence);
+
+    for (u32 idx = 0; idx < upload->upload_count; idx++) {
+        Upload *transfer = &upload->uploads[idx];
+
+        if (transfer->owned) {
+            vkDestroyBuffer(ctx->driver, transfer->src, NULL);
+            vk_memory_free(ctx, &transfer->src_mem);
+        }
+    }
+
+    // reclaim the regions read by the batch
+    upload->staging.tail = upload->staging.submitted;
+
+    if (upload->staging.tail == upload->staging.head) {
+        upload->staging.head = 0;
+        upload->staging.tail = 0;
+        upload->staging.submitted = 0;
+    }
+
+    upload->upload_count = 0;
+    upload->in_flight = false;
+
+    return success;
+}
+
+void vk_upload_context_destroy(RenderContext *ctx) {
+    UploadContext *upload = &ctx->upload;
+
+    vk_upload_wait(ctx);
+
+    vkDestroySemaphore(ctx->driver, upload->semaphore, NULL);
+    vkDestroyFence(ctx->driver, upload->fence, NULL);
+
+    // destroying the pool frees `cmd_buf`
+    vkDestroyCommandPool(ctx->driver, upload->cmd_pool, NULL);
+
+    vkDestroyBuffer(ctx->driver, upload->staging.buf, NULL);
+    vk_memory_free(ctx, &upload->staging.mem);
+
+    free(upload->uploads);
+    free(upload->buffer_acquires);
+    free(upload->image_acquires);
+}
+
+/* Releases the staging buffers of a batch in flight if it has completed,
+ * without blocking. */
+void vk_upload_poll(RenderContext *ctx) {
+    if (!ctx->upload.in_flight)
+        return;
+
+    if (vkGetFenceStatus(ctx->driver, ctx->upload.fence) == VK_SUCCESS)
+        vk_upload_wait(ctx);
+}
+
+Upload *vk_upload_push(RenderContext *ctx) {
+    UploadContext *upload = &ctx->upload;
+
+    // `uploads` still belongs to the batch executing on the GPU
+    if (upload->in_flight && !vk_upload_wait(ctx))
+        warn("failed to wait for previous uploads");
+
+    if (upload->upload_count == upload->upload_alloc_count) {
+        upload->upload_alloc_count = upload->upload_alloc_count * 2 + 16;
+        upload->uploads = vrealloc(
+            upload->uploads,
+            upload->upload_alloc_count * sizeof(Upload)
+        );
+    }
+
+    return &upload->uploads[upload->upload_count++];
+}
+
+/* Records every pending transfer into the upload command buffer.
+ *
+ * Images are transitioned with one barrier before and one barrier after all
+ * of the copies, instead of a submission per transition. When uploading
+ * through a dedicated transfer queue family, the barrier after the copies
+ * releases ownership of every resource and matching acquire barriers are
+ * queued for the next frame. */
+bool vk_upload_record(RenderContext *ctx) {
+    UploadContext *upload = &ctx->upload;
+    bool dedicated = ctx->transfer_family != ctx->queue_family;
+    VkImageMemoryBarrier *image_barriers;
+    VkBufferMemoryBarrier *buffer_barriers;
+    u32 image_count = 0, buffer_count = 0;
+    VkPipelineStageFlags dst_stage;
 
-    VkCommandBuffer cmd_buf;
-    VkBufferCopy copy_region = {
-        .size = size
+    VkCommandBufferBeginInfo begin_info = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT
     };
 
-    if (!vk_cmd_oneshot_start(ctx, &cmd_buf))
+    if (vkBeginCommandBuffer(upload->cmd_buf, &begin_info)) {
+        error("failed to begin upload command buffer");
         return false;
+    }
+
+    image_barriers = vmalloc(
+        upload->upload_count * sizeof(VkImageMemoryBarrier)
+    );
+
+    buffer_barriers = vmalloc(
+        upload->upload_count * sizeof(VkBufferMemoryBarrier)
+    );
+
+    for (u32 idx = 0; idx < upload->upload_count; idx++) {
+        Upload *transfer = &upload->uploads[idx];
+
+        if (transfer->type == UPLOAD_BUFFER) {
+            buffer_barriers[buffer_count++] = (VkBufferMemoryBarrier) {
+                .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+                .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+                .dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT |
+                                 VK_ACCESS_INDEX_READ_BIT,
+                .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                .buffer = transfer->dst_buf,
+                .offset = 0,
+                .size = transfer->size,
+            };
+
+            continue;
+        }
+
+        image_barriers[image_count++] = (VkImageMemoryBarrier) {
+            .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+            .oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+            .newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            .srcAccessMask = 0,
+            .dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+            .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .image = transfer->dst_image,
+            .subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+            .subresourceRange.baseMipLevel = 0,
+            .subresourceRange.levelCount = 1,
+            .subresourceRange.baseArrayLayer = 0,
+            .subresourceRange.layerCount = 1,
+        };
+    }
+
+    // uploads only ever write to resources no frame has read yet
+    vkCmdPipelineBarrier(
+        upload->cmd_buf,
+        VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, // stage before barrier
+        VK_PIPELINE_STAGE_TRANSFER_BIT, // stage after barrier
+        0,
+        0,
+        NULL,
+        0,
+        NULL,
+        image_count,
+        image_barriers
+    );
+
+    for (u32 idx = 0; idx < upload->upload_count; idx++) {
+        Upload *transfer = &upload->uploads[idx];
+
+        if (transfer->type == UPLOAD_BUFFER) {
+            VkBufferCopy copy_region = {
+                .srcOffset = transfer->src_offset,
+                .size = transfer->size
+            };
+
+            vkCmdCopyBuffer(
+                upload->cmd_buf,
+                transfer->src,
+                transfer->dst_buf,
+                1,
+                &copy_region
+            );
+        } else {
+            VkBufferImageCopy region = {
+                .bufferOffset = transfer->src_offset,
+                .bufferRowLength = 0,
+                .bufferImageHeight = 0,
+                .imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                .imageSubresource.mipLevel = 0,
+                .imageSubresource.baseArrayLayer = 0,
+                .imageSubresource.layerCount = 1,
+                .imageOffset = { 0, 0, 0 },
+                .imageExtent = { transfer->width, transfer->height, 1 }
+            };
+
+            vkCmdCopyBufferToImage(
+                upload->cmd_buf,
+                transfer->src,
+                transfer->dst_image,
+                VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                1,
+                &region
+            );
+        }
+    }
+
+    for (u32 idx = 0; idx < image_count; idx++) {
+        image_barriers[idx].oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        image_barriers[idx].newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        image_barriers[idx].srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        image_barriers[idx].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    }
+
+    dst_stage = VK_PIPELINE_STAGE_VERTEX_INPUT_BIT |
+                VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+
+    if (dedicated) {
+        upload->buffer_acquires = vrealloc(
+            upload->buffer_acquires,
+            (upload->buffer_acquire_count + buffer_count) *
+            sizeof(VkBufferMemoryBarrier)
+        );
+
+        upload->image_acquires = vrealloc(
+            upload->image_acquires,
+            (upload->image_acquire_count + image_count) *
+            sizeof(VkImageMemoryBarrier)
+        );
+
+        // release and acquire barriers must match except for their access
+        // masks, which are ignored on the side they don't apply to
+        for (u32 idx = 0; idx < buffer_count; idx++) {
+            VkBufferMemoryBarrier *barrier = &buffer_barriers[idx];
+
+            barrier->srcQueueFamilyIndex = ctx->transfer_family;
+            barrier->dstQueueFamilyIndex = ctx->queue_family;
 
-    vkCmdCopyBuffer(cmd_buf, src, dst, 1, &copy_region);
+            upload->buffer_acquires[upload->buffer_acquire_count] = *barrier;
+            upload->buffer_acquires[upload->buffer_acquire_count++]
+                .srcAccessMask = 0;
 
-    if (!vk_cmd_oneshot_end(ctx, cmd_buf))
+            barrier->dstAccessMask = 0;
+        }
+
+        for (u32 idx = 0; idx < image_count; idx++) {
+            VkImageMemoryBarrier *barrier = &image_barriers[idx];
+
+            barrier->srcQueueFamilyIndex = ctx->transfer_family;
+            barrier->dstQueueFamilyIndex = ctx->queue_family;
+
+            upload->image_acquires[upload->image_acquire_count] = *barrier;
+            upload->image_acquires[upload->image_acquire_count++]
+                .srcAccessMask = 0;
+
+            barrier->dstAccessMask = 0;
+        }
+
+        dst_stage = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+    }
+
+    // make every transfer visible to the stages reading them, or release
+    // them to the graphics queue family
+    vkCmdPipelineBarrier(
+        upload->cmd_buf,
+        VK_PIPELINE_STAGE_TRANSFER_BIT,
+        dst_stage,
+        0,
+        0,
+        NULL,
+        buffer_count,
+        buffer_barriers,
+        image_count,
+        image_barriers
+    );
+
+    free(image_barriers);
+    free(buffer_barriers);
+
+    if (vkEndCommandBuffer(upload->cmd_buf)) {
+        error("failed to end upload command buffer");
         return false;
+    }
 
     return true;
 }
 
-bool vk_buffer_create(RenderContext *ctx, VkDeviceSize size,
-                      VkBufferUsageFlags usage,
-                      VkMemoryPropertyFlags flags,
-                      VkBuffer *buf, VkDeviceMemory *buf_mem) {
+/* Records the barriers acquiring every resource uploaded since the last
+ * frame from the transfer queue family.
+ *
+ * The first scope matches the stages `vk_engine_render` waits on the upload
+ * semaphore at, so the acquire and its layout transitions happen after the
+ * transfer queue is done with the resources. */
+void vk_upload_acquire_record(RenderContext *ctx, VkCommandBuffer cmd_buf) {
+    UploadContext *upload = &ctx->upload;
 
-    VkMemoryRequirements mem_reqs;
+    if (upload->buffer_acquire_count == 0 && upload->image_acquire_count == 0)
+        return;
 
-    VkBufferCreateInfo buf_info = {
-        .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
-        .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
-        .size = size,
-        .usage = usage,
-    };
+    vkCmdPipelineBarrier(
+        cmd_buf,
+        VK_PIPELINE_STAGE_VERTEX_INPUT_BIT |
+        VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+        VK_PIPELINE_STAGE_VERTEX_INPUT_BIT |
+        VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+        0,
+        0,
+        NULL,
+        upload->buffer_acquire_count,
+        upload->buffer_acquires,
+        upload->image_acquire_count,
+        upload->image_acquires
+    );
+
+    upload->buffer_acquire_count = 0;
+    upload->image_acquire_count = 0;
+}
+
+/* Drops every pending transfer of a batch that failed to be submitted.
+ *
+ * The callers destroy the destinations when an upload fails, so nothing
+ * may be left behind to be copied into them by the next batch. The staging
+ * buffers owned by the transfers are released and their regions of the ring
+ * are handed back. */
+void vk_upload_discard(RenderContext *ctx, u32 buffer_acquire_count,
+                       u32 image_acquire_count) {
+
+    UploadContext *upload = &ctx->upload;
+
+    for (u32 idx = 0; idx < upload->upload_count; idx++) {
+        Upload *transfer = &upload->uploads[idx];
+
+        if (transfer->owned) {
+            vkDestroyBuffer(ctx->driver, transfer->src, NULL);
+            vk_memory_free(ctx, &transfer->src_mem);
+        }
+    }
+
+    upload->staging.head = upload->staging.submitted;
+
+    if (upload->staging.tail == upload->staging.head) {
+        upload->staging.head = 0;
+        upload->staging.tail = 0;
+        upload->staging.submitted = 0;
+    }
+
+    // acquires queued by `vk_upload_record` for the dropped transfers
+    upload->buffer_acquire_count = buffer_acquire_count;
+    upload->image_acquire_count = image_acquire_count;
 
-    VkMemoryAllocateInfo alloc_info = {
-        .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+    upload->upload_count = 0;
+}
+
+/* Submits every pending transfer at once to the transfer queue.
+ *
+ * If `signal` is set, `semaphore` is signaled for the next frame to wait on
+ * instead of the host waiting on `fence`. If the batch can't be submitted
+ * it's discarded. */
+bool vk_upload_submit(RenderContext *ctx, bool signal) {
+    UploadContext *upload = &ctx->upload;
+    VkPipelineStageFlags wait_stage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+    u32 buffer_acquire_count = upload->buffer_acquire_count;
+    u32 image_acquire_count = upload->image_acquire_count;
+
+    VkSubmitInfo submit_info = {
+        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+        .pCommandBuffers = &upload->cmd_buf,
+        .commandBufferCount = 1,
     };
 
-    if (vkCreateBuffer(ctx->driver, &buf_info, NULL, buf))
+    if (!vk_upload_record(ctx)) {
+        vk_upload_discard(ctx, buffer_acquire_count, image_acquire_count);
         return false;
+    }
 
-    vkGetBufferMemoryRequirements(ctx->driver, *buf, &mem_reqs);
+    if (signal) {
+        // a semaphore that still hasn't been waited on by a frame is carried
+        // over to this batch, as it can't be signaled twice
+        if (upload->semaphore_pending) {
+            submit_info.pWaitSemaphores = &upload->semaphore;
+            submit_info.waitSemaphoreCount = 1;
+            submit_info.pWaitDstStageMask = &wait_stage;
+        }
 
-    alloc_info.allocationSize = mem_reqs.size;
-    alloc_info.memoryTypeIndex = vk_find_memory_type(
-        ctx,
-        mem_reqs,
-        flags
-    );
+        submit_info.pSignalSemaphores = &upload->semaphore;
+        submit_info.signalSemaphoreCount = 1;
+    }
 
-    if (vkAllocateMemory(ctx->driver, &alloc_info, NULL, buf_mem)) {
-        vkDestroyBuffer(ctx->driver, *buf, NULL);
-        error("failed to allocate buffer memory");
+    if (vkQueueSubmit(ctx->transfer_queue, 1, &submit_info, upload->fence)) {
+        error("failed to submit uploads to transfer queue");
+        vk_upload_discard(ctx, buffer_acquire_count, image_acquire_count);
         return false;
     }
 
-    if (vkBindBufferMemory(ctx->driver, *buf, *buf_mem, 0)) {
-        error("failed to bind buffer memory");
-        vkDestroyBuffer(ctx->driver, *buf, NULL);
-        vkFreeMemory(ctx->driver, *buf_mem, NULL);
+    trace("submitted %d uploads", upload->upload_count);
+
+    upload->staging.submitted = upload->staging.head;
+    upload->in_flight = true;
+    upload->semaphore_pending |= signal;
+
+    return true;
+}
+
+/* Holds every following transfer until `vk_upload_end`. */
+void vk_upload_begin(RenderContext *ctx) {
+    ctx->upload.batching = true;
+}
+
+/* Submits every pending transfer at once and waits for them to complete. */
+bool vk_upload_flush(RenderContext *ctx) {
+    if (ctx->upload.upload_count == 0 || ctx->upload.in_flight)
+        return vk_upload_wait(ctx);
+
+    if (!vk_upload_submit(ctx, false))
         return false;
+
+    return vk_upload_wait(ctx);
+}
+
+/* Stops batching and submits every transfer held since `vk_upload_begin`
+ * without waiting for them. Rendering continues while the transfer queue
+ * copies the batch, the next frame waits on the upload semaphore. */
+bool vk_upload_end(RenderContext *ctx) {
+    ctx->upload.batching = false;
+
+    if (ctx->upload.upload_count == 0 || ctx->upload.in_flight)
+        return true;
+
+    return vk_upload_submit(ctx, true);
+}
+
+/* Drops the pending acquire of a buffer uploaded through a dedicated
+ * transfer queue before it's destroyed, so the next frame doesn't record
+ * a barrier on it. Transfers into the buffer must have been flushed. */
+void vk_upload_forget_buffer(RenderContext *ctx, VkBuffer buf) {
+    UploadContext *upload = &ctx->upload;
+    u32 kept = 0;
+
+    for (u32 idx = 0; idx < upload->buffer_acquire_count; idx++) {
+        if (upload->buffer_acquires[idx].buffer != buf)
+            upload->buffer_acquires[kept++] = upload->buffer_acquires[idx];
     }
 
+    upload->buffer_acquire_count = kept;
+}
+
+/* Reserves `size` bytes of the staging ring aligned to `alignment`.
+ *
+ * If the ring is full, space is reclaimed by waiting on the batch in flight
+ * or by flushing pending transfers. Returns NULL if `size` bytes can't fit
+ * in the ring at all. */
+void *vk_staging_alloc(RenderContext *ctx, VkDeviceSize size,
+                       VkDeviceSize alignment, VkDeviceSize *offset) {
+
+    StagingRing *ring = &ctx->upload.staging;
+
+    for (;;) {
+        VkDeviceSize start = (ring->head + alignment - 1) & ~(alignment - 1);
+        bool fits = false;
+
+        // `head` never catches up to `tail`, so they're only equal when the
+        // ring is empty
+        if (ring->head >= ring->tail) {
+            if (start + size <= ring->size) {
+                fits = true;
+            } else if (size < ring->tail) {
+                // the end of the ring is skipped and reclaimed with the rest
+                start = 0;
+                fits = true;
+            }
+        } else if (start + size < ring->tail) {
+            fits = true;
+        }
+
+        if (fits) {
+            ring->head = start + size;
+            *offset = start;
+
+            return (u8 *)ring->mem.mapped + start;
+        }
+
+        if (ctx->upload.in_flight) {
+            if (!vk_upload_wait(ctx))
+                return NULL;
+        } else if (ctx->upload.upload_count != 0) {
+            if (!vk_upload_flush(ctx))
+                return NULL;
+        } else {
+            return NULL;
+        }
+    }
+}
+
+/* Copies `data` into the staging ring, or into a host visible buffer of
+ * its own if it's larger than the ring. */
+bool vk_upload_staging_create(RenderContext *ctx, Upload *transfer,
+                              const void *data, VkDeviceSize size) {
+
+    // satisfies the texel size of any format and the usual optimal
+    // buffer copy offset alignment
+    VkDeviceSize alignment = 16;
+    void *mapped;
+    bool success;
+
+    if (ctx->dev_prop.limits.optimalBufferCopyOffsetAlignment > alignment)
+        alignment = ctx->dev_prop.limits.optimalBufferCopyOffsetAlignment;
+
+    mapped = vk_staging_alloc(ctx, size, alignment, &transfer->src_offset);
+
+    if (mapped) {
+        memcpy(mapped, data, size);
+        transfer->src = ctx->upload.staging.buf;
+        transfer->owned = false;
+        return true;
+    }
+
+    warn("%lu bytes don't fit in the staging ring", (u64)size);
+
+    success = vk_buffer_create(
+        ctx,
+        size,
+        VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+        VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+        &transfer->src,
+        &transfer->src_mem
+    );
+
+    if (!success) {
+        error("failed to create staging buffer");
+        return false;
+    }
+
+    memcpy(transfer->src_mem.mapped, data, size);
+    transfer->src_offset = 0;
+    transfer->owned = true;
+
     return true;
 }
 
-bool vk_buffer_copy_to_image(RenderContext *ctx,
-                             VkBuffer buf, VkImage img,
-                             u32 width, u32 height) {
-    VkCommandBuffer cmd_buf;
+/* Copies `size` bytes of `data` into a newly created device local buffer
+ * through the staging ring. */
+bool vk_buffer_upload(RenderContext *ctx, VkBuffer dst, const void *data,
+                      VkDeviceSize size) {
 
-    VkBufferImageCopy region = {
-        .bufferOffset = 0,
-        .bufferRowLength = 0,
-        .bufferImageHeight = 0,
-        .imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
-        .imageSubresource.mipLevel = 0,
-        .imageSubresource.baseArrayLayer = 0,
-        .imageSubresource.layerCount = 1,
-        .imageOffset = { 0, 0, 0 },
-        .imageExtent = { width, height, 1 }
+    Upload transfer = {
+        .type = UPLOAD_BUFFER,
+        .dst_buf = dst,
+        .size = size,
     };
 
-    if (!vk_cmd_oneshot_start(ctx, &cmd_buf))
+    if (!vk_upload_staging_create(ctx, &transfer, data, size))
         return false;
 
-    vkCmdCopyBufferToImage(
-        cmd_buf,
-        buf,
-        img,
-        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-        1,
-        &region
-    );
+    *vk_upload_push(ctx) = transfer;
+
+    return ctx->upload.batching || vk_upload_flush(ctx);
+}
 
-    if (!vk_cmd_oneshot_end(ctx, cmd_buf))
+/* Copies the pixels of an image in the VK_IMAGE_LAYOUT_UNDEFINED layout
+ * through the staging ring, leaving it ready to be sampled. */
+bool vk_image_upload(RenderContext *ctx, VkImage dst, const void *pixels,
+                     VkDeviceSize size, u32 width, u32 height) {
+
+    Upload transfer = {
+        .type = UPLOAD_IMAGE,
+        .dst_image = dst,
+        .width = width,
+        .height = height,
+    };
+
+    if (!vk_upload_staging_create(ctx, &transfer, pixels, size))
         return false;
 
+    *vk_upload_push(ctx) = transfer;
+
+    return ctx->upload.batching || vk_upload_flush(ctx);
+}
+
+/* Marks every frame's copy of an object's vertices as outdated.
+ *
+ * The copies are refreshed by `vk_vertices_sync` once each frame is
+ * recorded, so moving an object never waits on the GPU. */
+bool vk_vertices_update(RenderContext *ctx, Object *obj) {
+    obj->stale_frames = (1 << ctx->frames_in_flight) - 1;
     return true;
 }
 
-/* Copies the vertices positions in `ctx->vertices` to the GPU. */
-bool vk_vertices_update(RenderContext *ctx, Object *obj, ObjectType type) {
-    VkDeviceSize buf_size = sizeof(Vertex) * obj->vertices_count;
-    bool success;
-    VkBuffer staging_buf;
-    void *gpu_mem;
-
-    switch (type) {
-    case OBJECT_PLAYER:
-        staging_buf = ctx->player_staging_buf;
-        gpu_mem = ctx->player_gpu_mem;
-        break;
-    case OBJECT_TILE:
-        staging_buf = ctx->tile_staging_buf;
-        gpu_mem = ctx->tile_gpu_mem;
-        break;
-    default:
-        error("Unknown object type");
-        return false;
-    }
+/* Copies an object's vertices moved by it's offset into the current frame's
+ * region of its vertex buffer if they're outdated. The frame's fence must
+ * have been waited on. */
+void vk_vertices_sync(RenderContext *ctx, Object *obj) {
+    Vertex *region = (Vertex *)obj->vertices_mem.mapped +
+                     ctx->frame * obj->vertices_count;
+
+    if (!(obj->stale_frames & (1 << ctx->frame)))
+        return;
+
+    for (u32 idx = 0; idx < obj->vertices_count; idx++) {
+        region[idx].pos[0] = obj->vertices[idx].pos[0] + obj->offset[0];
+        region[idx].pos[1] = obj->vertices[idx].pos[1] + obj->offset[1];
+        region[idx].tex[0] = obj->vertices[idx].tex[0];
+        region[idx].tex[1] = obj->vertices[idx].tex[1];
+    }
+
+    obj->stale_frames &= ~(1 << ctx->frame);
+}
+
+/* Creates a host visible vertex buffer with a region for every frame in
+ * flight, preferring memory that's also device local (ReBAR).
+ *
+ * Without resizable BAR that memory is a small heap which may not fit the
+ * buffer, or may not be allowed for it at all, so plain host visible memory
+ * is used instead. */
+bool vk_vertices_create(RenderContext *ctx, Object *obj) {
+    VkMemoryPropertyFlags rebar, flags;
+    VkDeviceSize buf_size;
+    bool success = false;
+
+    buf_size = sizeof(Vertex) * obj->vertices_count * ctx->frames_in_flight;
+
+    flags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+            VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    rebar = flags | VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
 
-    memcpy(gpu_mem, obj->vertices, buf_size);
+    for (u32 idx = 0; idx < ctx->mem_prop.memoryTypeCount; idx++) {
+        if ((ctx->mem_prop.memoryTypes[idx].propertyFlags & rebar) == rebar) {
+            success = vk_buffer_create(
+                ctx,
+                buf_size,
+                VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+                rebar,
+                &obj->vertices_buf,
+                &obj->vertices_mem
+            );
+            break;
+        }
+    }
 
-    success = vk_buffer_copy(
-        ctx,
-        obj->vertices_buf,
-        staging_buf,
-        buf_size
-    );
+    if (!success) {
+        success = vk_buffer_create(
+            ctx,
+            buf_size,
+            VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+            flags,
+            &obj->vertices_buf,
+            &obj->vertices_mem
+        );
+    }
 
     if (!success) {
-        error("failed to copy staging buffer into vertex buffer");
+        error("failed to create vertex buffer");
         return false;
     }
 
-    return true;
+    return vk_vertices_update(ctx, obj);
 }
 
-/* Create all required buffers for the vertices and maps GPU memory. */
-bool vk_vertices_create(RenderContext *ctx, Object *obj, ObjectType type) {
-    VkDeviceSize buf_size = sizeof(Vertex) * obj->vertices_count;
+/* Generates indices for `quad_count` quads and copies them to the GPU.
+ *
+ * Every quad is made up of 4 vertices which are split into 2 triangles. The
+ * same index buffer is shared by every object and sprite batch. Any previous
+ * index buffer is replaced. */
+bool vk_indices_create(RenderContext *ctx, u32 quad_count) {
+    VkDeviceSize buf_size = sizeof(u32) * 6 * quad_count;
     bool success;
 
+    // previous buffer might still be used by frames in flight or by a
+    // transfer held by the upload context
+    if (ctx->indices) {
+        if (!vk_upload_flush(ctx))
+            warn("failed to flush uploads before replacing index buffer");
+
+        vkDeviceWaitIdle(ctx->driver);
+        vk_upload_forget_buffer(ctx, ctx->indices_buf);
+        vkDestroyBuffer(ctx->driver, ctx->indices_buf, NULL);
+        vk_memory_free(ctx, &ctx->indices_mem);
+        free(ctx->indices);
+    }
+
+    /* --------------------- assign indices--------------------- */
+    ctx->indices_count = 6 * quad_count;
+    ctx->indices = vmalloc(ctx->indices_count * sizeof(u32));
+
+    for (u32 quad = 0; quad < quad_count; quad++) {
+        u32 *indices = &ctx->indices[quad * 6];
+        u32 vertex = quad * 4;
+
+        indices[0] = vertex + 0;
+        indices[1] = vertex + 1;
+        indices[2] = vertex + 2;
+        indices[3] = vertex + 2;
+        indices[4] = vertex + 3;
+        indices[5] = vertex + 0;
+    }
+    /* --------------------------------------------------------- */
+
     success = vk_buffer_create(
         ctx,
         buf_size,
         VK_BUFFER_USAGE_TRANSFER_DST_BIT |
-        VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+        VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
         VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-        &obj->vertices_buf,
-        &obj->vertices_mem
+        &ctx->indices_buf,
+        &ctx->indices_mem
     );
 
     if (!success) {
@@ -1391,148 +2486,179 @@ bool vk_vertices_create(RenderContext *ctx, Object *obj, ObjectType type) {
         return false;
     }
 
-    if (!vk_vertices_update(ctx, obj, type)) {
-        error("failed to update vertices");
-        vkDestroyBuffer(ctx->driver, obj->vertices_buf, NULL);
-        vkFreeMemory(ctx->driver, obj->vertices_mem, NULL);
+    if (!vk_buffer_upload(ctx, ctx->indices_buf, ctx->indices, buf_size)) {
+        error("failed to update indices");
+        vkDestroyBuffer(ctx->driver, ctx->indices_buf, NULL);
+        vk_memory_free(ctx, &ctx->indices_mem);
         return false;
     }
 
     return true;
 }
 
-/* Copies the vertices positions in `ctx->indices` to the GPU. */
-bool vk_indices_update(RenderContext *ctx) {
-    VkDeviceSize buf_size = sizeof(u16) * ctx->indices_count;
+/* Creates a vertex buffer holding every quad in the batch.
+ *
+ * The index buffer is grown if it can't index every quad of the batch. */
+bool vk_sprite_batch_create(RenderContext *ctx, SpriteBatch *batch) {
+    VkDeviceSize buf_size = sizeof(Vertex) * 4 * batch->quad_count;
     bool success;
 
-    memcpy(ctx->indices_gpu_mem, ctx->indices, buf_size);
+    if (batch->quad_count == 0)
+        return true;
+
+    if (ctx->indices_count < batch->quad_count * 6) {
+        if (!vk_indices_create(ctx, batch->quad_count)) {
+            error("failed to grow index buffer");
+            return false;
+        }
+    }
+
+    success = vk_buffer_create(
+        ctx,
+        buf_size,
+        VK_BUFFER_USAGE_TRANSFER_DST_BIT |
+        VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        &batch->vertices_buf,
+        &batch->vertices_mem
+    );
+
+    if (!success) {
+        error("failed to create sprite batch vertex buffer");
+        return false;
+    }
 
-    success = vk_buffer_copy(
+    success = vk_buffer_upload(
         ctx,
-        ctx->indices_buf,
-        ctx->indices_staging_buf,
+        batch->vertices_buf,
+        batch->vertices,
         buf_size
     );
 
     if (!success) {
-        error("failed to copy staging buffer into index buffer");
+        error("failed to upload sprite batch vertices");
+        vkDestroyBuffer(ctx->driver, batch->vertices_buf, NULL);
+        vk_memory_free(ctx, &batch->vertices_mem);
         return false;
     }
 
     return true;
 }
 
-/* Create all required buffers for the indices and maps GPU memory. 
- *
- * Only creates vertices for squares as that's all we're using right now. */
-bool vk_indices_create(RenderContext *ctx) {
-    VkDeviceSize buf_size = sizeof(u16) * 6;
+void vk_sprite_batch_destroy(RenderContext *ctx, SpriteBatch *batch) {
+    if (batch->quad_count != 0) {
+        vk_upload_forget_buffer(ctx, batch->vertices_buf);
+        vkDestroyBuffer(ctx->driver, batch->vertices_buf, NULL);
+        vk_memory_free(ctx, &batch->vertices_mem);
+    }
+
+    free(batch->vertices);
+}
+
+/* Creates the GPU resources drawing a chunk's tiles, a buffer read once per
+ * instance by the tile pipeline or a sprite batch when instancing is
+ * disabled. */
+bool vk_tile_chunk_create(RenderContext *ctx, TileChunk *chunk) {
+    VkDeviceSize buf_size = sizeof(TileInstance) * chunk->tile_count;
     bool success;
 
-    /* --------------------- assign indices--------------------- */
-    ctx->indices_count = 6;
-    ctx->indices = vmalloc(ctx->indices_count * sizeof(u16));
-
-    ctx->indices[0] = 0;
-    ctx->indices[1] = 1;
-    ctx->indices[2] = 2;
-    ctx->indices[3] = 2;
-    ctx->indices[4] = 3;
-    ctx->indices[5] = 0;
-    /* --------------------------------------------------------- */
+    chunk->batch.vertices = NULL;
+    chunk->batch.quad_count = 0;
+    chunk->batch.quad_alloc_count = 0;
+    chunk->batch.texture = &ctx->atlas.texture;
+
+    if (!ctx->instancing) {
+        level_chunk_batch(ctx, chunk);
+
+        if (vk_sprite_batch_create(ctx, &chunk->batch))
+            return true;
+
+        // the batch has no buffer left, leave it empty so the chunk can
+        // still be marked loaded and destroyed like any other
+        free(chunk->batch.vertices);
+        chunk->batch.vertices = NULL;
+        chunk->batch.quad_count = 0;
+        chunk->batch.quad_alloc_count = 0;
+        return false;
+    }
+
+    if (chunk->tile_count == 0)
+        return true;
 
     success = vk_buffer_create(
         ctx,
         buf_size,
         VK_BUFFER_USAGE_TRANSFER_DST_BIT |
-        VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+        VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
         VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-        &ctx->indices_buf,
-        &ctx->indices_mem
+        &chunk->tiles_buf,
+        &chunk->tiles_mem
     );
 
     if (!success) {
-        error("failed to create index buffer");
+        error("failed to create tile instance buffer");
         return false;
     }
 
-    if (!vk_indices_update(ctx)) {
-        error("failed to update indices");
-        vkDestroyBuffer(ctx->driver, ctx->indices_buf, NULL);
-        vkFreeMemory(ctx->driver, ctx->indices_mem, NULL);
+    success = vk_buffer_upload(ctx, chunk->tiles_buf, chunk->tiles, buf_size);
+
+    if (!success) {
+        error("failed to upload tile instances");
+        vkDestroyBuffer(ctx->driver, chunk->tiles_buf, NULL);
+        vk_memory_free(ctx, &chunk->tiles_mem);
         return false;
     }
 
     return true;
 }
 
+/* Destroys a chunk created by `vk_tile_chunk_create`, or one that never
+ * finished loading. */
+void vk_tile_chunk_destroy(RenderContext *ctx, TileChunk *chunk) {
+    if (chunk->loaded && !ctx->instancing) {
+        vk_sprite_batch_destroy(ctx, &chunk->batch);
+    } else if (chunk->loaded && chunk->tile_count != 0) {
+        vk_upload_forget_buffer(ctx, chunk->tiles_buf);
+        vkDestroyBuffer(ctx->driver, chunk->tiles_buf, NULL);
+        vk_memory_free(ctx, &chunk->tiles_mem);
+    }
 
-/* Transform image data to a layout more memory cache friendly to the GPU. */
-bool vk_image_layout_transition(RenderContext *ctx, VkImage img,
-                                VkImageLayout old_layout,
-                                VkImageLayout new_layout) {
-
-    VkCommandBuffer cmd_buf;
-    VkPipelineStageFlags src_stage, dst_stage;
+    free(chunk->kept_tiles);
+}
 
-    VkImageMemoryBarrier barrier = {
-        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
-        .oldLayout = old_layout,
-        .newLayout = new_layout,
-        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-        .image = img,
-        .subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
-        .subresourceRange.baseMipLevel = 0,
-        .subresourceRange.levelCount = 1,
-        .subresourceRange.baseArrayLayer = 0,
-        .subresourceRange.layerCount = 1,
+/* Creates the unit square that tile instances are expanded from.
+ *
+ * Corners are in the same order as an object's vertices so they can be
+ * drawn using the first 6 indices of the index buffer. */
+bool vk_quad_create(RenderContext *ctx) {
+    Vertex quad[4] = {
+        { .pos = { 0.0, 0.0 }, .tex = { 0.0, 0.0 } },
+        { .pos = { 1.0, 0.0 }, .tex = { 1.0, 0.0 } },
+        { .pos = { 1.0, 1.0 }, .tex = { 1.0, 1.0 } },
+        { .pos = { 0.0, 1.0 }, .tex = { 0.0, 1.0 } },
     };
 
-    if (!vk_cmd_oneshot_start(ctx, &cmd_buf))
-        return false;
-
-    if (old_layout == VK_IMAGE_LAYOUT_UNDEFINED &&
-        new_layout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL) {
-        barrier.srcAccessMask = 0;
-        barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-
-        src_stage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
-        dst_stage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-    }
-
-    if (old_layout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL &&
-        new_layout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL) {
-        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-
-        src_stage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-        dst_stage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
-    }
+    bool success = vk_buffer_create(
+        ctx,
+        sizeof(quad),
+        VK_BUFFER_USAGE_TRANSFER_DST_BIT |
+        VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        &ctx->quad_buf,
+        &ctx->quad_mem
+    );
 
-    if (!src_stage || !dst_stage) {
-        error("unsupported layout transition");
+    if (!success) {
+        error("failed to create unit quad buffer");
         return false;
     }
 
-    // stages docs:
-    // https://registry.khronos.org/vulkan/specs/1.3-extensions/html/chap7.html#synchronization-access-types-supported
-    vkCmdPipelineBarrier(
-        cmd_buf,
-        src_stage, // stage before barrier
-        dst_stage, // stage after barrier
-        0,
-        0,
-        NULL,
-        0,
-        NULL,
-        1,
-        &barrier
-    );
-
-    if (!vk_cmd_oneshot_end(ctx, cmd_buf))
+    if (!vk_buffer_upload(ctx, ctx->quad_buf, quad, sizeof(quad))) {
+        error("failed to upload unit quad");
+        vkDestroyBuffer(ctx->driver, ctx->quad_buf, NULL);
+        vk_memory_free(ctx, &ctx->quad_mem);
         return false;
+    }
 
     return true;
 }
@@ -1541,6 +2667,7 @@ bool vk_image_texture_create(RenderContext *ctx,
                              Texture *tex,
                              SDL_Surface *img) {
     VkMemoryRequirements mem_reqs;
+    bool success;
 
     VkImageCreateInfo image_info = {
         .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
@@ -1559,32 +2686,29 @@ bool vk_image_texture_create(RenderContext *ctx,
         .extent.height = (u32)img->h
     };
 
-    VkMemoryAllocateInfo alloc_info = {
-        .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
-    };
-
     if (vkCreateImage(ctx->driver, &image_info, NULL, &tex->image))
         return false;
 
     vkGetImageMemoryRequirements(ctx->driver, tex->image, &mem_reqs);
 
-    alloc_info.allocationSize = mem_reqs.size;
-    alloc_info.memoryTypeIndex = vk_find_memory_type(
+    success = vk_memory_alloc(
         ctx,
         mem_reqs,
-        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        false,
+        &tex->mem
     );
 
-    if (vkAllocateMemory(ctx->driver, &alloc_info, NULL, &tex->mem)) {
+    if (!success) {
         error("failed to allocate image texture");
         vkDestroyImage(ctx->driver, tex->image, NULL);
         return false;
     }
 
-    if (vkBindImageMemory(ctx->driver, tex->image, tex->mem, 0)) {
+    if (vkBindImageMemory(ctx->driver, tex->image, tex->mem.mem, tex->mem.offset)) {
         error("failed to bind image texture memory");
         vkDestroyImage(ctx->driver, tex->image, NULL);
-        vkFreeMemory(ctx->driver, tex->mem, NULL);
+        vk_memory_free(ctx, &tex->mem);
         return false;
     }
 
@@ -1593,126 +2717,184 @@ bool vk_image_texture_create(RenderContext *ctx,
 
 bool vk_image_from_surface(RenderContext *ctx, Texture *tex, SDL_Surface *img) {
     VkDeviceSize img_size;
-    VkDeviceMemory staging_buf_mem;
-    VkBuffer staging_buf;
-    void *data;
     bool success;
 
     img_size = img->w * img->h * img->format->BytesPerPixel;
 
-    success = vk_buffer_create(
-        ctx,
-        img_size,
-        VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
-        VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-        &staging_buf,
-        &staging_buf_mem
-    );
-
-    if (!success) {
-        error("failed to create image buffer");
-        return false;
-    }
-
-    if (vkMapMemory(ctx->driver, staging_buf_mem, 0, img_size, 0, &data)) {
-        error("failed to map vertex buffer memory");
-        vkDestroyBuffer(ctx->driver, staging_buf, NULL);
-        return false;
-    }
-
-    memcpy(data, img->pixels, img_size);
-    vkUnmapMemory(ctx->driver, staging_buf_mem);
-
     if (!vk_image_texture_create(ctx, tex, img)) {
         error("failed to create image texture");
-        vkDestroyBuffer(ctx->driver, staging_buf, NULL);
-        vkFreeMemory(ctx->driver, staging_buf_mem, NULL);
         return false;
     }
 
-    // change layout from any undefined data to an optimized format
-    success = vk_image_layout_transition(
+    success = vk_image_view_create(
         ctx,
         tex->image,
-        VK_IMAGE_LAYOUT_UNDEFINED,
-        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL
+        VK_FORMAT_B8G8R8A8_SRGB,
+        &tex->view
     );
 
     if (!success) {
-        error("failed to transition image to optimal layout");
-        vkDestroyBuffer(ctx->driver, staging_buf, NULL);
-        vkFreeMemory(ctx->driver, staging_buf_mem, NULL);
+        error("failed to create image texture view");
         vkDestroyImage(ctx->driver, tex->image, NULL);
+        vk_memory_free(ctx, &tex->mem);
         return false;
     }
 
-    success = vk_buffer_copy_to_image(
+    success = vk_image_upload(
         ctx,
-        staging_buf,
         tex->image,
+        img->pixels,
+        img_size,
         img->w,
         img->h
     );
 
     if (!success) {
-        error("failed to copy staging buffer into VkImage");
-        vkDestroyBuffer(ctx->driver, staging_buf, NULL);
-        vkFreeMemory(ctx->driver, staging_buf_mem, NULL);
+        error("failed to upload image texture");
+        vkDestroyImageView(ctx->driver, tex->view, NULL);
         vkDestroyImage(ctx->driver, tex->image, NULL);
+        vk_memory_free(ctx, &tex->mem);
         return false;
     }
 
-    success = vk_image_layout_transition(
-        ctx,
-        tex->image,
-        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-        VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
-    );
+    return true;
+}
 
-    if (!success) {
-        error("failed to transition image to a optimal read-only layout");
-        vkDestroyBuffer(ctx->driver, staging_buf, NULL);
-        vkFreeMemory(ctx->driver, staging_buf_mem, NULL);
-        vkDestroyImage(ctx->driver, tex->image, NULL);
-        return false;
+/* Destroys the image, view and memory of a texture created by
+ * `vk_image_from_surface` that has no sampler or descriptors yet.
+ *
+ * The upload of the image may still be held by the upload context, it's
+ * flushed first and the pending acquire of the image is dropped. */
+void vk_image_destroy(RenderContext *ctx, Texture *tex) {
+    UploadContext *upload = &ctx->upload;
+    u32 kept = 0;
+
+    if (!vk_upload_flush(ctx))
+        warn("failed to flush uploads before destroying image");
+
+    for (u32 idx = 0; idx < upload->image_acquire_count; idx++) {
+        if (upload->image_acquires[idx].image != tex->image)
+            upload->image_acquires[kept++] = upload->image_acquires[idx];
     }
 
-    success = vk_image_view_create(
-        ctx,
-        tex->image,
-        VK_FORMAT_B8G8R8A8_SRGB,
-        &tex->view
-    );
+    upload->image_acquire_count = kept;
 
-    if (!success) {
-        error("failed to create image texture view");
-        vkDestroyBuffer(ctx->driver, staging_buf, NULL);
-        vkFreeMemory(ctx->driver, staging_buf_mem, NULL);
-        vkDestroyImage(ctx->driver, tex->image, NULL);
-        return false;
+    vkDestroyImageView(ctx->driver, tex->view, NULL);
+    vkDestroyImage(ctx->driver, tex->image, NULL);
+    vk_memory_free(ctx, &tex->mem);
+}
+
+void vk_texture_destroy(RenderContext *ctx, Texture *tex) {
+    // the slot is only rewritten once another texture claims it
+    if (ctx->bindless) {
+        ctx->bindless_free[ctx->bindless_free_count++] = tex->index;
+    } else {
+        vkFreeDescriptorSets(
+            ctx->driver,
+            ctx->desc_pool,
+            ctx->frames_in_flight,
+            tex->desc_sets
+        );
+
+        free(tex->desc_sets);
+        tex->desc_sets = NULL;
     }
 
-    vkDestroyBuffer(ctx->driver, staging_buf, NULL);
-    vkFreeMemory(ctx->driver, staging_buf_mem, NULL);
+    vk_image_destroy(ctx, tex);
+}
 
-    return true;
+/* Bytes of a VkSamplerCreateInfo that determine the resulting sampler,
+ * skipping the structure type and extension chain. */
+#define SAMPLER_KEY_OFFSET offsetof(VkSamplerCreateInfo, flags)
+#define SAMPLER_KEY_SIZE                                          \
+    (offsetof(VkSamplerCreateInfo, unnormalizedCoordinates) +     \
+     sizeof(VkBool32) - SAMPLER_KEY_OFFSET)
+
+/* Returns the slot holding a sampler created with `info` or the empty slot
+ * it would be inserted into. */
+SamplerEntry *sampler_cache_find(SamplerCache *cache,
+                                 const VkSamplerCreateInfo *info, u32 hash) {
+
+    const u8 *key = (const u8 *)info + SAMPLER_KEY_OFFSET;
+    u32 mask = cache->capacity - 1;
+
+    for (u32 idx = hash & mask;; idx = (idx + 1) & mask) {
+        SamplerEntry *entry = &cache->entries[idx];
+
+        if (entry->sampler == VK_NULL_HANDLE)
+            return entry;
+
+        if (entry->hash != hash)
+            continue;
+
+        if (memcmp((u8 *)&entry->info + SAMPLER_KEY_OFFSET, key, SAMPLER_KEY_SIZE) == 0)
+            return entry;
+    }
+}
+
+/* Doubles the number of slots, keeping the table at most 3/4 full. */
+void sampler_cache_grow(SamplerCache *cache) {
+    SamplerEntry *entries = cache->entries;
+    u32 capacity = cache->capacity;
+
+    cache->capacity = capacity ? capacity * 2 : 16;
+    cache->entries = vcalloc(cache->capacity * sizeof(SamplerEntry));
+
+    for (u32 idx = 0; idx < capacity; idx++) {
+        SamplerEntry *entry = &entries[idx];
+
+        if (entry->sampler != VK_NULL_HANDLE)
+            *sampler_cache_find(cache, &entry->info, entry->hash) = *entry;
+    }
+
+    free(entries);
 }
 
-/* BMP Images are cached and not freed till the end of the program.
+/* Finds a sampler created with the same parameters as `info`, creating it
+ * if there isn't one yet.
  *
- * Therefore if a texture has already been loaded it will try to reuse it */
-bool vk_image_create(RenderContext *ctx, Texture *tex, const char *path) {
-    SDL_Surface *surface = sdl_load_image(path);
-    bool success;
+ * Samplers are owned by the cache and live until the engine is destroyed,
+ * `info` mustn't have an extension chain. */
+bool vk_sampler_get(RenderContext *ctx, const VkSamplerCreateInfo *info,
+                    VkSampler *sampler) {
 
-    if (!surface)
-        return false;
+    SamplerCache *cache = &ctx->samplers;
+    SamplerEntry *entry;
+    u32 hash = hash_bytes((const u8 *)info + SAMPLER_KEY_OFFSET, SAMPLER_KEY_SIZE);
 
-    success = vk_image_from_surface(ctx, tex, surface);
-    SDL_FreeSurface(surface);
+    if ((cache->count + 1) * 4 > cache->capacity * 3)
+        sampler_cache_grow(cache);
 
-    return success;
+    entry = sampler_cache_find(cache, info, hash);
+
+    if (entry->sampler == VK_NULL_HANDLE) {
+        if (vkCreateSampler(ctx->driver, info, NULL, &entry->sampler))
+            return false;
+
+        entry->info = *info;
+        entry->hash = hash;
+        cache->count++;
+
+        trace("created sampler %d of %d", cache->count,
+              ctx->dev_prop.limits.maxSamplerAllocationCount);
+    }
+
+    *sampler = entry->sampler;
+    return true;
+}
+
+void vk_sampler_cache_destroy(RenderContext *ctx) {
+    SamplerCache *cache = &ctx->samplers;
+
+    for (u32 idx = 0; idx < cache->capacity; idx++) {
+        if (cache->entries[idx].sampler != VK_NULL_HANDLE)
+            vkDestroySampler(ctx->driver, cache->entries[idx].sampler, NULL);
+    }
+
+    free(cache->entries);
+    cache->entries = NULL;
+    cache->count = 0;
+    cache->capacity = 0;
 }
 
 bool vk_image_sampler_create(RenderContext *ctx, Texture *tex) {
@@ -1735,12 +2917,34 @@ bool vk_image_sampler_create(RenderContext *ctx, Texture *tex) {
         .maxLod = 0.0,
     };
 
-    return vkCreateSampler(
-        ctx->driver,
-        &sampler_info,
-        NULL,
-        &tex->sampler
-    ) == VK_SUCCESS;
+    return vk_sampler_get(ctx, &sampler_info, &tex->sampler);
+}
+
+/* Sampler for a texture packing many sprites edge to edge.
+ *
+ * Tile UVs land exactly on the borders between sprites, a linear filter
+ * would blend every tile's edge with its neighbour in the atlas. */
+bool vk_atlas_sampler_create(RenderContext *ctx, Texture *tex) {
+    VkSamplerCreateInfo sampler_info = {
+        .sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
+        .magFilter = VK_FILTER_NEAREST,
+        .minFilter = VK_FILTER_NEAREST,
+        .addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+        .addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+        .addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+        .anisotropyEnable = VK_FALSE,
+        .maxAnisotropy = 1.0,
+        .borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK,
+        .unnormalizedCoordinates = VK_FALSE,
+        .compareEnable = VK_FALSE,
+        .compareOp = VK_COMPARE_OP_ALWAYS,
+        .mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST,
+        .mipLodBias = 0.0,
+        .minLod = 0.0,
+        .maxLod = 0.0,
+    };
+
+    return vk_sampler_get(ctx, &sampler_info, &tex->sampler);
 }
 
 bool vk_sync_primitives_create(RenderContext *ctx) {
@@ -1753,7 +2957,7 @@ bool vk_sync_primitives_create(RenderContext *ctx) {
         .flags = VK_FENCE_CREATE_SIGNALED_BIT
     };
 
-    for (u32 idx = 0; idx < MAX_FRAMES_LOADED; idx++) {
+    for (u32 idx = 0; idx < ctx->frames_in_flight; idx++) {
         VkResult vk_fail = VK_SUCCESS;
         Synchronization *sync = &ctx->sync[idx];
 
@@ -1773,118 +2977,87 @@ bool vk_sync_primitives_create(RenderContext *ctx) {
 
         vk_fail |= vkCreateFence(
             ctx->driver,
-            &fence_info,
-            NULL,
-            &sync->renderers_busy
-        );
-
-        if (vk_fail)
-            return false;
-    }
-
-    return true;
-}
-
-bool vk_staging_buffer_create(RenderContext *ctx,
-                              VkBuffer *buf,
-                              VkDeviceMemory *mem,
-                              void **gpu_mem,
-                              VkDeviceSize size) {
-
-    bool success = vk_buffer_create(
-        ctx,
-        size,
-        VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
-        VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-        buf,
-        mem
-    );
-
-    if (!success) {
-        error("failed to create staging buffer");
-        return false;
-    }
-
-    if(vkMapMemory(ctx->driver, *mem, 0, size, 0, gpu_mem)) {
-        error("failed to map buffer memory");
-        vkDestroyBuffer(ctx->driver, *buf, NULL);
-        vkFreeMemory(ctx->driver, *mem, NULL);
-        return false;
-    }
-
-    return true;
-}
-
-bool vk_staging_buffers_create(RenderContext *ctx) {
-    bool success = true;
-
-    success |= !vk_staging_buffer_create(
-        ctx,
-        &ctx->player_staging_buf,
-        &ctx->player_staging_mem,
-        &ctx->player_gpu_mem,
-        254 * 254 * sizeof(Vertex)
-    );
-
-    success |= !vk_staging_buffer_create(
-        ctx,
-        &ctx->tile_staging_buf,
-        &ctx->tile_staging_mem,
-        &ctx->tile_gpu_mem,
-        16 * 16 * sizeof(Vertex)
-    );
-
-    success |= !vk_staging_buffer_create(
-        ctx,
-        &ctx->indices_staging_buf,
-        &ctx->indices_staging_mem,
-        &ctx->indices_gpu_mem,
-        6 * sizeof(u16)
-    );
-
-    return success;
-}
-
-void vk_staging_buffers_destroy(RenderContext *ctx) {
-    // destroy staging buffers
-    vkDestroyBuffer(ctx->driver, ctx->indices_staging_buf, NULL);
-    vkDestroyBuffer(ctx->driver, ctx->player_staging_buf, NULL);
-    vkDestroyBuffer(ctx->driver, ctx->tile_staging_buf, NULL);
+            &fence_info,
+            NULL,
+            &sync->renderers_busy
+        );
 
-    // unmap staging buffer memory
-    vkUnmapMemory(ctx->driver, ctx->indices_staging_mem);
-    vkUnmapMemory(ctx->driver, ctx->player_staging_mem);
-    vkUnmapMemory(ctx->driver, ctx->tile_staging_mem);
+        if (vk_fail)
+            return false;
+    }
 
-    // free staging buffer memory
-    vkFreeMemory(ctx->driver, ctx->indices_staging_mem, NULL);
-    vkFreeMemory(ctx->driver, ctx->player_staging_mem, NULL);
-    vkFreeMemory(ctx->driver, ctx->tile_staging_mem, NULL);
+    return true;
 }
 
 void vk_sync_primitives_destroy(RenderContext *ctx) {
-    for (u32 idx = 0; idx < MAX_FRAMES_LOADED; idx++) {
+    for (u32 idx = 0; idx < ctx->frames_in_flight; idx++) {
         Synchronization *sync = &ctx->sync[idx];
 
         vkDestroySemaphore(ctx->driver, sync->images_available, NULL);
         vkDestroySemaphore(ctx->driver, sync->renders_finished, NULL);
         vkDestroyFence(ctx->driver, sync->renderers_busy, NULL);
     }
+
+    free(ctx->sync);
+    ctx->sync = NULL;
 }
 
 void vk_engine_create(RenderContext *ctx) {
+    GpuAllocatorStats stats;
+
     ctx->frame = 0;
-    ctx->object_count = 0;
-    ctx->object_alloc_count = 0;
+    ctx->frame_count = 0;
+    ctx->objects = (ObjectStore) {};
+    ctx->stream = (ChunkStreamer) {};
+    ctx->layer_count = 0;
+    ctx->layers = NULL;
+    ctx->level = (Level) {};
+    ctx->pack = (AssetPack) {};
+    ctx->indices = NULL;
+    ctx->allocator.blocks = NULL;
+    ctx->allocator.block_count = 0;
+    ctx->samplers.entries = NULL;
+    ctx->samplers.count = 0;
+    ctx->samplers.capacity = 0;
+    ctx->collision.cells = NULL;
+    ctx->collision.size[0] = 0;
+    ctx->collision.size[1] = 0;
+    ctx->draw_count = 0;
+    ctx->draw_capacity = 0;
+
+    ctx->camera = (Camera) {
+        .pos = { 0.0, 0.0 },
+        .scale = { 2.0 / VIEW_WIDTH, 2.0 / VIEW_HEIGHT }
+    };
 
+    // 2x2 tiles in the middle of the first screen
     static f32 guy[4][2] = {
-        { -1.0/16.0, -1.0/9.0 },
-        {  1.0/16.0, -1.0/9.0 },
-        {  1.0/16.0,  1.0/9.0 },
-        { -1.0/16.0,  1.0/9.0 }
+        { 15.0,  8.0 },
+        { 17.0,  8.0 },
+        { 17.0, 10.0 },
+        { 15.0, 10.0 }
     };
 
+    if (ctx->frames_in_flight == 0) {
+        ctx->frames_in_flight = DEFAULT_FRAMES_LOADED;
+    } else if (ctx->frames_in_flight > MAX_FRAMES_LOADED) {
+        warn(
+            "%d frames in flight requested, using %d",
+            ctx->frames_in_flight,
+            MAX_FRAMES_LOADED
+        );
+
+        ctx->frames_in_flight = MAX_FRAMES_LOADED;
+    }
+
+    info("%d frames in flight", ctx->frames_in_flight);
+
+    ctx->cmd_bufs = vmalloc(ctx->frames_in_flight * sizeof(VkCommandBuffer));
+    ctx->static_bufs = vmalloc(ctx->frames_in_flight * sizeof(VkCommandBuffer));
+    ctx->dynamic_bufs = vmalloc(ctx->frames_in_flight * sizeof(VkCommandBuffer));
+    vk_static_layers_invalidate(ctx);
+    ctx->sync = vmalloc(ctx->frames_in_flight * sizeof(Synchronization));
+
     if (!vk_instance_create(ctx))
         panic("failed to create instance");
 
@@ -1915,33 +3088,77 @@ void vk_engine_create(RenderContext *ctx) {
     if (!vk_descriptor_pool_create(ctx))
         panic("failed to create descriptor pool");
 
-    if (!vk_cmd_buffers_alloc(ctx, ctx->cmd_bufs, MAX_FRAMES_LOADED))
+    if (!vk_camera_create(ctx))
+        panic("failed to create camera");
+
+    if (!vk_cmd_buffers_alloc(ctx,
+                              ctx->cmd_bufs,
+                              ctx->frames_in_flight,
+                              VK_COMMAND_BUFFER_LEVEL_PRIMARY))
         panic("failed to create command buffer");
 
+    if (!vk_cmd_buffers_alloc(ctx,
+                              ctx->static_bufs,
+                              ctx->frames_in_flight,
+                              VK_COMMAND_BUFFER_LEVEL_SECONDARY))
+        panic("failed to create static layer command buffers");
+
+    if (!vk_cmd_buffers_alloc(ctx,
+                              ctx->dynamic_bufs,
+                              ctx->frames_in_flight,
+                              VK_COMMAND_BUFFER_LEVEL_SECONDARY))
+        panic("failed to create object command buffers");
+
     if (!vk_sync_primitives_create(ctx))
         panic("failed to create synchronization primitives");
 
-    if (!vk_staging_buffers_create(ctx))
-        panic("failed to create staging buffers");
+    if (!vk_upload_context_create(ctx))
+        panic("failed to create upload context");
 
-    if (!vk_indices_create(ctx))
+    if (!vk_indices_create(ctx, 1))
         panic("failed to create GPU index buffer for a square");
 
-    level_map_load(
-        ctx,
-        "./assets/map_1_Tile Layer 2.csv",
-        "./assets/tileset.bmp"
-    );
+    if (!vk_quad_create(ctx))
+        panic("failed to create GPU vertex buffer for a unit square");
 
-    level_map_load(
-        ctx,
-        "./assets/map_1_Tile Layer 1.csv",
-        "./assets/tileset.bmp"
-    );
+    // images are converted ahead of time by `make assets`
+    if (!asset_pack_load(ctx, "./target/assets.pack"))
+        warn("no asset pack, images are loaded and converted one by one");
 
-    if (!object_create(ctx, guy, "./assets/guy.bmp"))
+    // record every transfer of the level and submit them at once
+    vk_upload_begin(ctx);
+
+    if (!level_load(ctx, "./target/map_1.lvl"))
+        panic("failed to load level, was it compiled with `make levels`?");
+
+    if (!level_atlas_load(ctx))
+        panic("failed to load tileset atlas");
+
+    if (!object_create(ctx, guy, "./assets/guy.bmp", NULL))
         panic("failed to create object");
 
+    if (!level_stream_start(ctx))
+        panic("failed to start streaming the level");
+
+    // the first frame shouldn't pop in
+    level_stream_wait(ctx);
+
+    if (!vk_upload_end(ctx))
+        panic("failed to upload level");
+
+    vk_allocator_stats(ctx, &stats);
+
+    info(
+        "%d resources in %d memory blocks, %lu of %lu bytes used, "
+        "%d free ranges, largest %lu bytes",
+        stats.allocation_count,
+        stats.block_count,
+        (u64)stats.used,
+        (u64)stats.reserved,
+        stats.free_range_count,
+        (u64)stats.largest_free_range
+    );
+
     info("vulkan engine created");
 }
 
@@ -1949,25 +3166,58 @@ void vk_engine_destroy(RenderContext *ctx) {
     vkDeviceWaitIdle(ctx->driver);
 
     objects_destroy(ctx);
+    textures_destroy(ctx);
+    level_layers_destroy(ctx);
+    level_unload(ctx);
+    level_atlas_destroy(ctx);
+    asset_pack_unload(ctx);
 
-    vk_staging_buffers_destroy(ctx);
     vkDestroyBuffer(ctx->driver, ctx->indices_buf, NULL);
-    vkFreeMemory(ctx->driver, ctx->indices_mem, NULL);
+    vk_memory_free(ctx, &ctx->indices_mem);
+    vkDestroyBuffer(ctx->driver, ctx->quad_buf, NULL);
+    vk_memory_free(ctx, &ctx->quad_mem);
     vk_sync_primitives_destroy(ctx);
+    vk_upload_context_destroy(ctx);
+    vk_sampler_cache_destroy(ctx);
+    vk_camera_destroy(ctx);
+
+    if (ctx->draw_capacity != 0) {
+        vkDestroyBuffer(ctx->driver, ctx->draws_buf, NULL);
+        vk_memory_free(ctx, &ctx->draws_mem);
+    }
 
     vkFreeCommandBuffers(ctx->driver,
         ctx->cmd_pool,
-        MAX_FRAMES_LOADED,
+        ctx->frames_in_flight,
         ctx->cmd_bufs
     );
 
+    vkFreeCommandBuffers(ctx->driver,
+        ctx->cmd_pool,
+        ctx->frames_in_flight,
+        ctx->static_bufs
+    );
+
+    vkFreeCommandBuffers(ctx->driver,
+        ctx->cmd_pool,
+        ctx->frames_in_flight,
+        ctx->dynamic_bufs
+    );
+
+    free(ctx->cmd_bufs);
+    free(ctx->static_bufs);
+    free(ctx->dynamic_bufs);
+
     // destroy vertices
     vkDestroyCommandPool(ctx->driver, ctx->cmd_pool, NULL);
     vkDestroyDescriptorPool(ctx->driver, ctx->desc_pool, NULL);
+    free(ctx->bindless_free);
     free(ctx->indices);
 
     vk_pipeline_destroy(ctx);
+    vk_allocator_destroy(ctx);
     vkDestroyDescriptorSetLayout(ctx->driver, ctx->desc_set_layout, NULL);
+    vkDestroyDescriptorSetLayout(ctx->driver, ctx->camera_layout, NULL);
     vkDestroyRenderPass(ctx->driver, ctx->render_pass, NULL);
     vk_swapchain_destroy(ctx);
     vkDestroyDevice(ctx->driver, NULL);
@@ -1987,75 +3237,424 @@ void vk_engine_destroy(RenderContext *ctx) {
  * 4. Submit the recorded command buffer
  * 5. Present the swap chain image */
 
-bool vk_record_cmd_buffer(RenderContext *ctx,
-                          VkCommandBuffer cmd_buf,
-                          u32 img_idx) {
-
-    VkDeviceSize offsets[1] = {0};
+/* Makes `tex` the texture sampled by the following draw calls.
+ *
+ * In bindless mode only the texture's index is pushed, the texture array
+ * is bound once per command buffer by `vk_record_secondary_begin`. */
+void vk_record_texture_bind(RenderContext *ctx, VkCommandBuffer cmd_buf,
+                            Texture *tex) {
 
-    VkCommandBufferBeginInfo begin_info = {
-        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
-        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT
+    DrawConstants draw = {
+        .texture = tex->index
     };
 
-    // black with 100% opacity
-    VkClearValue clear_color = {{{0.0, 0.0, 0.0, 0.0}}};
-
-    VkRenderPassBeginInfo render_pass_info = {
-        .sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
-        .renderPass = ctx->render_pass,
-        .framebuffer = ctx->swapchain.framebuffers[img_idx],
-        .renderArea.offset = {0, 0},
-        .renderArea.extent = ctx->dimensions,
-        .pClearValues = &clear_color,
-        .clearValueCount = 1,
-    };
+    if (ctx->bindless) {
+        vkCmdPushConstants(
+            cmd_buf,
+            ctx->pipeline_layout,
+            VK_SHADER_STAGE_FRAGMENT_BIT,
+            sizeof(TileGrid),
+            sizeof(DrawConstants),
+            &draw
+        );
 
-    if (vkBeginCommandBuffer(cmd_buf, &begin_info))
-        return false;
+        return;
+    }
 
-    /* ------------------------ render pass ------------------------ */
-    vkCmdBeginRenderPass(
+    vkCmdBindDescriptorSets(
         cmd_buf,
-        &render_pass_info,
-        VK_SUBPASS_CONTENTS_INLINE
+        VK_PIPELINE_BIND_POINT_GRAPHICS,
+        ctx->pipeline_layout,
+        0,
+        1,
+        &tex->desc_sets[ctx->frame],
+        0,
+        NULL
+    );
+}
+
+/* Offset into `draws_buf` of a chunk's indirect draw in the current frame. */
+VkDeviceSize vk_chunk_draw_offset(RenderContext *ctx, TileLayer *layer, u32 chunk) {
+    u32 draw = ctx->frame * ctx->draw_capacity + layer->draw_offset + chunk;
+
+    return draw * sizeof(VkDrawIndexedIndirectCommand);
+}
+
+/* Makes room for an indirect draw per chunk of every layer, for every frame
+ * in flight.
+ *
+ * Growing the buffer waits for the device to go idle, the static layers of
+ * every frame are outdated by then anyway. */
+bool vk_chunk_draws_reserve(RenderContext *ctx) {
+    VkDeviceSize buf_size;
+    bool success;
+
+    ctx->draw_count = 0;
+
+    for (u32 idx = 0; idx < ctx->layer_count; idx++) {
+        ctx->layers[idx].draw_offset = ctx->draw_count;
+        ctx->draw_count += ctx->layers[idx].chunk_count;
+    }
+
+    if (ctx->draw_count <= ctx->draw_capacity)
+        return true;
+
+    if (ctx->draw_capacity != 0) {
+        vkDeviceWaitIdle(ctx->driver);
+        vkDestroyBuffer(ctx->driver, ctx->draws_buf, NULL);
+        vk_memory_free(ctx, &ctx->draws_mem);
+    }
+
+    ctx->draw_capacity = ctx->draw_count * 2;
+    buf_size = sizeof(VkDrawIndexedIndirectCommand) *
+               ctx->draw_capacity * ctx->frames_in_flight;
+
+    success = vk_buffer_create(
+        ctx,
+        buf_size,
+        VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+        VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+        &ctx->draws_buf,
+        &ctx->draws_mem
     );
 
+    if (!success) {
+        error("failed to create indirect draw buffer");
+        ctx->draw_capacity = 0;
+        return false;
+    }
+
+    return true;
+}
+
+/* Writes the current frame's indirect draws, chunks that are off screen
+ * draw nothing. The draws themselves are recorded once by
+ * `vk_record_static_layers`. */
+void vk_chunks_cull(RenderContext *ctx) {
+    VkDrawIndexedIndirectCommand *draws = ctx->draws_mem.mapped;
+
+    if (ctx->draw_capacity == 0)
+        return;
+
+    draws += ctx->frame * ctx->draw_capacity;
+
+    for (u32 idx = 0; idx < ctx->layer_count; idx++) {
+        TileLayer *layer = &ctx->layers[idx];
+
+        for (u32 chunk_idx = 0; chunk_idx < layer->chunk_count; chunk_idx++) {
+            TileChunk *chunk = &layer->chunks[chunk_idx];
+            VkDrawIndexedIndirectCommand *draw = &draws[layer->draw_offset + chunk_idx];
+            u32 count = chunk->loaded ? chunk->tile_count : 0;
+            ObjectBounds bounds = {
+                .min = {
+                    chunk->pos[0] * CHUNK_SIZE,
+                    chunk->pos[1] * CHUNK_SIZE
+                },
+                .max = {
+                    (chunk->pos[0] + 1) * CHUNK_SIZE,
+                    (chunk->pos[1] + 1) * CHUNK_SIZE
+                }
+            };
+            bool visible = camera_sees(ctx, &bounds);
+
+            // instanced chunks draw an instance per tile, batched chunks a
+            // quad per tile
+            if (ctx->instancing) {
+                *draw = (VkDrawIndexedIndirectCommand) {
+                    .indexCount = 6,
+                    .instanceCount = visible ? count : 0,
+                };
+            } else {
+                *draw = (VkDrawIndexedIndirectCommand) {
+                    .indexCount = count * 6,
+                    .instanceCount = visible ? 1 : 0,
+                };
+            }
+        }
+    }
+}
+
+/* Writes the camera into the current frame's copy of it. */
+void vk_camera_update(RenderContext *ctx) {
+    u8 *mapped = ctx->camera_mem.mapped;
+
+    memcpy(mapped + ctx->frame * ctx->camera_stride, &ctx->camera, sizeof(Camera));
+}
+
+/* Draws every tile layer with an instanced indirect draw per resident
+ * chunk. */
+void vk_record_tile_layers(RenderContext *ctx, VkCommandBuffer cmd_buf) {
+    VkDeviceSize offsets[2] = {0, 0};
+    VkBuffer bufs[2] = { ctx->quad_buf, VK_NULL_HANDLE };
+
     vkCmdBindPipeline(
         cmd_buf,
         VK_PIPELINE_BIND_POINT_GRAPHICS,
-        ctx->pipeline
+        ctx->tile_pipeline
+    );
+
+    vkCmdPushConstants(
+        cmd_buf,
+        ctx->pipeline_layout,
+        VK_SHADER_STAGE_VERTEX_BIT,
+        0,
+        sizeof(TileGrid),
+        &ctx->grid
     );
 
+    vk_record_texture_bind(ctx, cmd_buf, &ctx->atlas.texture);
+
+    for (u32 idx = 0; idx < ctx->layer_count; idx++) {
+        TileLayer *layer = &ctx->layers[idx];
+
+        for (u32 chunk = 0; chunk < layer->chunk_count; chunk++) {
+            if (!layer->chunks[chunk].loaded || layer->chunks[chunk].tile_count == 0)
+                continue;
+
+            bufs[1] = layer->chunks[chunk].tiles_buf;
+
+            vkCmdBindVertexBuffers(cmd_buf, 0, 2, bufs, offsets);
+            vkCmdDrawIndexedIndirect(
+                cmd_buf,
+                ctx->draws_buf,
+                vk_chunk_draw_offset(ctx, layer, chunk),
+                1,
+                sizeof(VkDrawIndexedIndirectCommand)
+            );
+        }
+    }
+}
+
+/* Draws every tile layer as a CPU expanded sprite batch with an indirect
+ * draw per chunk, expects the object pipeline to be bound. */
+void vk_record_sprite_batches(RenderContext *ctx, VkCommandBuffer cmd_buf) {
+    VkDeviceSize offsets[1] = {0};
+
+    vk_record_texture_bind(ctx, cmd_buf, &ctx->atlas.texture);
+
+    for (u32 idx = 0; idx < ctx->layer_count; idx++) {
+        TileLayer *layer = &ctx->layers[idx];
+
+        for (u32 chunk = 0; chunk < layer->chunk_count; chunk++) {
+            SpriteBatch *batch = &layer->chunks[chunk].batch;
+
+            if (!layer->chunks[chunk].loaded || batch->quad_count == 0)
+                continue;
+
+            vkCmdBindVertexBuffers(cmd_buf, 0, 1, &batch->vertices_buf, offsets);
+            vkCmdDrawIndexedIndirect(
+                cmd_buf,
+                ctx->draws_buf,
+                vk_chunk_draw_offset(ctx, layer, chunk),
+                1,
+                sizeof(VkDrawIndexedIndirectCommand)
+            );
+        }
+    }
+}
+
+/* Marks the static layers of every frame in flight as outdated, they're
+ * re-recorded the next time each frame is drawn. */
+void vk_static_layers_invalidate(RenderContext *ctx) {
+    ctx->static_stale_frames = (1 << ctx->frames_in_flight) - 1;
+}
+
+/* Begins a secondary command buffer continuing the render pass.
+ *
+ * Dynamic state and bindings aren't inherited from the primary command
+ * buffer, so the viewport, scissor, index buffer and texture array are set
+ * again. */
+bool vk_record_secondary_begin(RenderContext *ctx,
+                               VkCommandBuffer cmd_buf,
+                               VkCommandBufferUsageFlags flags) {
+
+    // the framebuffer is left out so the recording works for any image
+    VkCommandBufferInheritanceInfo inheritance = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO,
+        .renderPass = ctx->render_pass,
+        .subpass = 0,
+        .framebuffer = VK_NULL_HANDLE
+    };
+
+    VkCommandBufferBeginInfo begin_info = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT | flags,
+        .pInheritanceInfo = &inheritance
+    };
+
+    if (vkBeginCommandBuffer(cmd_buf, &begin_info))
+        return false;
+
     // setting necessary dynamic state
     vkCmdSetViewport(cmd_buf, 0, 1, &ctx->viewport);
     vkCmdSetScissor(cmd_buf, 0, 1, &ctx->scissor);
 
-    // draw every object, it's vertices and indices.
-    for (u32 idx = 0; idx < ctx->object_count; idx++) {
-        Object *obj = &ctx->objects[idx];
+    // every quad shares the same index buffer
+    vkCmdBindIndexBuffer(cmd_buf, ctx->indices_buf, 0, VK_INDEX_TYPE_UINT32);
+
+    // the camera is read from the frame's copy once the buffer executes
+    vkCmdBindDescriptorSets(
+        cmd_buf,
+        VK_PIPELINE_BIND_POINT_GRAPHICS,
+        ctx->pipeline_layout,
+        1,
+        1,
+        &ctx->camera_sets[ctx->frame],
+        0,
+        NULL
+    );
 
+    // both pipelines share a layout so the texture array stays bound
+    if (ctx->bindless) {
         vkCmdBindDescriptorSets(
             cmd_buf,
             VK_PIPELINE_BIND_POINT_GRAPHICS,
             ctx->pipeline_layout,
             0,
             1,
-            &obj->texture.desc_sets[ctx->frame],
+            &ctx->bindless_set,
             0,
             NULL
         );
+    }
 
-        vkCmdBindIndexBuffer(cmd_buf,
-            ctx->indices_buf,
-            0,
-            VK_INDEX_TYPE_UINT16
+    return true;
+}
+
+/* Records the tile layers into the current frame's static command buffer,
+ * unless they haven't changed since it was last recorded.
+ *
+ * The frame's fence must have been waited on. */
+bool vk_record_static_layers(RenderContext *ctx) {
+    VkCommandBuffer cmd_buf = ctx->static_bufs[ctx->frame];
+
+    if (!(ctx->static_stale_frames & (1 << ctx->frame)))
+        return true;
+
+    if (!vk_chunk_draws_reserve(ctx))
+        return false;
+
+    vkResetCommandBuffer(cmd_buf, 0);
+
+    if (!vk_record_secondary_begin(ctx, cmd_buf, 0))
+        return false;
+
+    if (ctx->instancing) {
+        vk_record_tile_layers(ctx, cmd_buf);
+    } else {
+        vkCmdBindPipeline(
+            cmd_buf,
+            VK_PIPELINE_BIND_POINT_GRAPHICS,
+            ctx->pipeline
         );
 
-        vkCmdBindVertexBuffers(cmd_buf, 0, 1, &obj->vertices_buf, offsets);
-        vkCmdDrawIndexed(cmd_buf, ctx->indices_count, 1, 0, 0, 0);
+        vk_record_sprite_batches(ctx, cmd_buf);
+    }
+
+    if (vkEndCommandBuffer(cmd_buf))
+        return false;
+
+    ctx->static_stale_frames &= ~(1 << ctx->frame);
+    return true;
+}
+
+/* Records every object into the current frame's dynamic command buffer. */
+bool vk_record_objects(RenderContext *ctx) {
+    VkCommandBuffer cmd_buf = ctx->dynamic_bufs[ctx->frame];
+
+    vkResetCommandBuffer(cmd_buf, 0);
+
+    if (!vk_record_secondary_begin(ctx, cmd_buf,
+                                   VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT))
+        return false;
+
+    vkCmdBindPipeline(
+        cmd_buf,
+        VK_PIPELINE_BIND_POINT_GRAPHICS,
+        ctx->pipeline
+    );
+
+    // draw every object on screen, it's vertices and indices.
+    for (u32 idx = 0; idx < ctx->objects.count; idx++) {
+        Object *obj = &ctx->objects.objects[idx];
+        ObjectBounds bounds;
+        VkDeviceSize offset;
+
+        object_drawn_bounds(ctx, idx, &bounds);
+
+        // stays outdated until it's back on screen
+        if (!camera_sees(ctx, &bounds))
+            continue;
+
+        vk_vertices_sync(ctx, obj);
+        offset = ctx->frame * sizeof(Vertex) * obj->vertices_count;
+
+        vk_record_texture_bind(ctx, cmd_buf, ctx->objects.textures[idx]);
+
+        vkCmdBindVertexBuffers(cmd_buf, 0, 1, &obj->vertices_buf, &offset);
+        vkCmdDrawIndexed(cmd_buf, 6, 1, 0, 0, 0);
+    }
+
+    return vkEndCommandBuffer(cmd_buf) == VK_SUCCESS;
+}
+
+/* Records the frame's primary command buffer, which only begins the render
+ * pass and executes the static layers followed by the objects. */
+bool vk_record_cmd_buffer(RenderContext *ctx,
+                          VkCommandBuffer cmd_buf,
+                          u32 img_idx) {
+
+    VkCommandBuffer secondary[2] = {
+        ctx->static_bufs[ctx->frame],
+        ctx->dynamic_bufs[ctx->frame]
+    };
+
+    VkCommandBufferBeginInfo begin_info = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT
+    };
+
+    // black with 100% opacity
+    VkClearValue clear_color = {{{0.0, 0.0, 0.0, 0.0}}};
+
+    VkRenderPassBeginInfo render_pass_info = {
+        .sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
+        .renderPass = ctx->render_pass,
+        .framebuffer = ctx->swapchain.framebuffers[img_idx],
+        .renderArea.offset = {0, 0},
+        .renderArea.extent = ctx->dimensions,
+        .pClearValues = &clear_color,
+        .clearValueCount = 1,
+    };
+
+    if (!vk_record_static_layers(ctx)) {
+        error("failed to record static layers");
+        return false;
+    }
+
+    vk_camera_update(ctx);
+    vk_chunks_cull(ctx);
+
+    if (!vk_record_objects(ctx)) {
+        error("failed to record objects");
+        return false;
     }
 
+    if (vkBeginCommandBuffer(cmd_buf, &begin_info))
+        return false;
+
+    // take ownership of resources uploaded through the transfer queue
+    vk_upload_acquire_record(ctx, cmd_buf);
+
+    /* ------------------------ render pass ------------------------ */
+    vkCmdBeginRenderPass(
+        cmd_buf,
+        &render_pass_info,
+        VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS
+    );
+
+    vkCmdExecuteCommands(cmd_buf, 2, secondary);
     vkCmdEndRenderPass(cmd_buf);
 
     return vkEndCommandBuffer(cmd_buf) == VK_SUCCESS;
@@ -2067,13 +3666,20 @@ void vk_engine_render(RenderContext* ctx) {
     Synchronization *sync = &ctx->sync[ctx->frame];
     VkCommandBuffer cmd_buf = ctx->cmd_bufs[ctx->frame];
 
-    VkPipelineStageFlags wait_stages[1] = {
-        VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT
+    VkPipelineStageFlags wait_stages[2] = {
+        VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+        VK_PIPELINE_STAGE_VERTEX_INPUT_BIT |
+        VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT
+    };
+
+    VkSemaphore wait_semaphores[2] = {
+        sync->images_available,
+        ctx->upload.semaphore
     };
 
     VkSubmitInfo submit_info = {
         .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
-        .pWaitSemaphores = &sync->images_available,
+        .pWaitSemaphores = wait_semaphores,
         .waitSemaphoreCount = 1,
         .pWaitDstStageMask = wait_stages,
         .pCommandBuffers = &ctx->cmd_bufs[ctx->frame],
@@ -2110,15 +3716,25 @@ void vk_engine_render(RenderContext* ctx) {
 
     vkResetFences(ctx->driver, 1, &sync->renderers_busy);
     vkResetCommandBuffer(cmd_buf, 0);
+    ctx->frame_count++;
+
+    // release staging buffers of uploads that completed in the background
+    vk_upload_poll(ctx);
 
     vk_record_cmd_buffer(ctx, cmd_buf, img_idx);
 
+    // don't read anything uploaded by a batch still on the transfer queue
+    if (ctx->upload.semaphore_pending)
+        submit_info.waitSemaphoreCount = 2;
+
     if (vkQueueSubmit(ctx->queue, 1, &submit_info, sync->renderers_busy)) {
         error("failed to submit command buffer to queue");
-        ctx->frame = (ctx->frame + 1) % MAX_FRAMES_LOADED;
+        ctx->frame = (ctx->frame + 1) % ctx->frames_in_flight;
         return;
     }
 
+    ctx->upload.semaphore_pending = false;
+
     vk_fail = vkQueuePresentKHR(ctx->queue, &present_info);
 
     if (vk_fail == VK_SUBOPTIMAL_KHR || vk_fail == VK_ERROR_OUT_OF_DATE_KHR) {
@@ -2130,9 +3746,9 @@ void vk_engine_render(RenderContext* ctx) {
 
     if (vk_fail) {
         warn("failed to present queue");
-        ctx->frame = (ctx->frame + 1) % MAX_FRAMES_LOADED;
+        ctx->frame = (ctx->frame + 1) % ctx->frames_in_flight;
         return;
     }
 
-    ctx->frame = (ctx->frame + 1) % MAX_FRAMES_LOADED;
+    ctx->frame = (ctx->frame + 1) % ctx->frames_in_flight;
 }
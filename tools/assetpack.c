@@ -0,0 +1,165 @@
+#include "utils.h"
+#include "render.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Packs BMP images into a single asset pack that's mapped into memory by
+ * `asset_pack_load`, see `PackHeader` for the layout.
+ *
+ * usage: assetpack OUTPUT IMAGE...
+ *
+ * Images are converted to `SDL_PIXELFORMAT_BGRA32` here and looked up at
+ * runtime by the exact path they're given as, like "./assets/guy.bmp". */
+
+/* Image loaded and converted for the pack */
+typedef struct {
+    /* Path the image is looked up by */
+    const char *path;
+
+    /* The image in `SDL_PIXELFORMAT_BGRA32` */
+    SDL_Surface *surface;
+
+    /* Slot of the image in the directory */
+    u32 slot;
+} PackedImage;
+
+u64 align_to(u64 offset, u64 alignment) {
+    return (offset + alignment - 1) / alignment * alignment;
+}
+
+/* Loads an image and converts it to the format textures are created in. */
+SDL_Surface *image_load(const char *path) {
+    SDL_Surface *img, *conv_img;
+
+    if (!(img = SDL_LoadBMP(path))) {
+        error("failed to load image: '%s': %s", path, SDL_GetError());
+        return NULL;
+    }
+
+    conv_img = SDL_ConvertSurfaceFormat(img, SDL_PIXELFORMAT_BGRA32, 0);
+    SDL_FreeSurface(img);
+
+    if (!conv_img)
+        error("failed to convert image: '%s': %s", path, SDL_GetError());
+
+    return conv_img;
+}
+
+i32 main(i32 argc, char **argv) {
+    PackHeader header = {
+        .magic = PACK_MAGIC,
+        .version = PACK_VERSION,
+        .slot_count = 2,
+    };
+    PackedImage *images;
+    PackEntry *slots;
+    u64 offset;
+    u8 *data;
+    FILE *out;
+
+    if (argc < 2) {
+        error("usage: %s OUTPUT IMAGE...", argv[0]);
+        return 1;
+    }
+
+    images = vmalloc((argc - 2) * sizeof(PackedImage) + 1);
+
+    for (i32 arg = 2; arg < argc; arg++) {
+        PackedImage *image = &images[header.image_count];
+
+        image->path = argv[arg];
+
+        if (!(image->surface = image_load(argv[arg])))
+            return 1;
+
+        header.image_count++;
+    }
+
+    // keep the directory at most half full so probes stay short
+    while (header.slot_count < header.image_count * 2)
+        header.slot_count *= 2;
+
+    header.directory_offset = align_to(sizeof(PackHeader), 8);
+    slots = vcalloc(header.slot_count * sizeof(PackEntry));
+    offset = header.directory_offset + header.slot_count * sizeof(PackEntry);
+
+    for (u32 idx = 0; idx < header.image_count; idx++) {
+        PackedImage *image = &images[idx];
+        u32 key = hash(image->path);
+        u32 mask = header.slot_count - 1;
+        u32 slot = key & mask;
+
+        while (slots[slot].path_length != 0)
+            slot = (slot + 1) & mask;
+
+        image->slot = slot;
+        slots[slot] = (PackEntry) {
+            .key = key,
+            .path_length = strlen(image->path),
+            .path_offset = offset,
+            .size = { image->surface->w, image->surface->h },
+        };
+
+        offset += slots[slot].path_length + 1;
+    }
+
+    for (u32 idx = 0; idx < header.image_count; idx++) {
+        PackEntry *entry = &slots[images[idx].slot];
+
+        offset = align_to(offset, PACK_ALIGNMENT);
+        entry->pixels_offset = offset;
+        offset += (u64)entry->size[0] * entry->size[1] * 4;
+    }
+
+    data = vcalloc(offset);
+    memcpy(data, &header, sizeof(PackHeader));
+    memcpy(&data[header.directory_offset], slots, header.slot_count * sizeof(PackEntry));
+
+    for (u32 idx = 0; idx < header.image_count; idx++) {
+        PackedImage *image = &images[idx];
+        PackEntry *entry = &slots[image->slot];
+        u32 row_size = entry->size[0] * 4;
+
+        memcpy(&data[entry->path_offset], image->path, entry->path_length + 1);
+
+        // rows are tightly packed, unlike the surface's
+        for (u32 row = 0; row < entry->size[1]; row++) {
+            memcpy(
+                &data[entry->pixels_offset + (u64)row * row_size],
+                (u8 *)image->surface->pixels + row * image->surface->pitch,
+                row_size
+            );
+        }
+
+        SDL_FreeSurface(image->surface);
+    }
+
+    if (!(out = fopen(argv[1], "wb"))) {
+        error("failed to create asset pack: '%s'", argv[1]);
+        return 1;
+    }
+
+    if (fwrite(data, offset, 1, out) != 1) {
+        error("failed to write asset pack: '%s'", argv[1]);
+        fclose(out);
+        remove(argv[1]);
+        return 1;
+    }
+
+    fclose(out);
+
+    info(
+        "packed %d images into '%s', %lu bytes",
+        header.image_count,
+        argv[1],
+        offset
+    );
+
+    free(data);
+    free(slots);
+    free(images);
+
+    return 0;
+}
@@ -0,0 +1,126 @@
+#include "utils.h"
+#include "render.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/* Benchmarks `broadphase_update` with 1k, 10k and 100k movers wandering
+ * around a world sized to keep the number of neighbours per mover
+ * constant. Brute force pairwise checks are timed as a baseline where they
+ * finish in reasonable time. */
+
+#define BENCH_TICKS 100
+
+/* Side length of every mover */
+#define MOVER_SIZE 1.0
+
+/* Area of the world per mover */
+#define MOVER_SPACE 16.0
+
+static u32 SEED = 0x9E3779B9;
+
+f32 random_unit() {
+    SEED = SEED * 1664525u + 1013904223u;
+    return (f32)(SEED >> 8) / (f32)(1 << 24);
+}
+
+u32 brute_force_pairs(const ObjectBounds *bounds, u32 count) {
+    u32 pairs = 0;
+
+    for (u32 a = 0; a < count; a++) {
+        for (u32 b = a + 1; b < count; b++) {
+            if (bounds[a].min[0] > bounds[b].max[0] ||
+                bounds[a].max[0] < bounds[b].min[0] ||
+                bounds[a].min[1] > bounds[b].max[1] ||
+                bounds[a].max[1] < bounds[b].min[1])
+                continue;
+
+            pairs++;
+        }
+    }
+
+    return pairs;
+}
+
+/* Returns false if the sweep disagrees with brute force. */
+bool bench(u32 count) {
+    Broadphase phase = {};
+    ObjectBounds *bounds = vmalloc(count * sizeof(ObjectBounds));
+    f32 (*velocity)[2] = vmalloc(count * sizeof(f32[2]));
+    f32 side = sqrt(count * MOVER_SPACE);
+    struct timespec start;
+    f64 elapsed;
+    u64 pairs = 0;
+    bool success = true;
+
+    for (u32 idx = 0; idx < count; idx++) {
+        bounds[idx].min[0] = random_unit() * side;
+        bounds[idx].min[1] = random_unit() * side;
+        bounds[idx].max[0] = bounds[idx].min[0] + MOVER_SIZE;
+        bounds[idx].max[1] = bounds[idx].min[1] + MOVER_SIZE;
+
+        velocity[idx][0] = (random_unit() - 0.5) * 0.1;
+        velocity[idx][1] = (random_unit() - 0.5) * 0.1;
+    }
+
+    // the first update sorts from scratch
+    now(&start);
+    broadphase_update(&phase, bounds, count);
+    elapsed = time_elapsed(&start);
+
+    printf("%6u movers: initial sort   %8.3f ms, %u pairs\n",
+           count, elapsed * 1000.0, phase.pair_count);
+
+    now(&start);
+
+    for (u32 tick = 0; tick < BENCH_TICKS; tick++) {
+        for (u32 idx = 0; idx < count; idx++) {
+            for (u32 axis = 0; axis < 2; axis++) {
+                bounds[idx].min[axis] += velocity[idx][axis];
+                bounds[idx].max[axis] += velocity[idx][axis];
+            }
+        }
+
+        broadphase_update(&phase, bounds, count);
+        pairs += phase.pair_count;
+    }
+
+    elapsed = time_elapsed(&start);
+
+    printf("%6u movers: sort and sweep %8.3f ms/tick, %lu pairs/tick\n",
+           count, elapsed * 1000.0 / BENCH_TICKS, pairs / BENCH_TICKS);
+
+    if (count <= 10000) {
+        u32 brute_pairs;
+
+        now(&start);
+        brute_pairs = brute_force_pairs(bounds, count);
+        elapsed = time_elapsed(&start);
+
+        printf("%6u movers: brute force    %8.3f ms/tick, %u pairs/tick\n",
+               count, elapsed * 1000.0, brute_pairs);
+
+        if (brute_pairs != phase.pair_count) {
+            error("broadphase found %d pairs instead of %d",
+                  phase.pair_count, brute_pairs);
+            success = false;
+        }
+    }
+
+    broadphase_destroy(&phase);
+    free(velocity);
+    free(bounds);
+
+    return success;
+}
+
+i32 main() {
+    bool success = true;
+
+    success &= bench(1000);
+    success &= bench(10000);
+    success &= bench(100000);
+
+    return success ? 0 : 1;
+}
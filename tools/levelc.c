@@ -0,0 +1,501 @@
+#include "utils.h"
+#include "render.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Compiles the CSV layers of a Tiled map into a level that's mapped into
+ * memory by `level_load`, see `LevelHeader` for the layout.
+ *
+ * usage: levelc OUTPUT TILESET SOLID_TILES LAYER...
+ *
+ * TILESET is the Tiled tileset (.tsx) the tiles index into, the level
+ * refers to its image so it's loaded along with it. SOLID_TILES lists the
+ * sprites movers collide with. Layers are drawn in the order they're
+ * given. Tiles outside of the tileset are dropped here, the runtime only
+ * drops them again for stale or corrupt levels. */
+
+/* Tiles of a single CSV layer, -1 for empty cells */
+typedef struct {
+    /* Sprite of every cell, row by row */
+    i32 *cells;
+
+    /* Size of the layer in tiles, its widest row by its number of rows */
+    u32 size[2];
+} CsvLayer;
+
+/* Tileset described by a Tiled tileset file */
+typedef struct {
+    /* Size in pixels of a single sprite */
+    u32 tile_size[2];
+
+    /* Number of whole sprites along each axis of the image */
+    u32 sprites[2];
+
+    /* Path of the image, relative to the working directory */
+    char *image;
+} Tileset;
+
+/* Reads the size in pixels of a BMP file from its header. */
+bool bmp_size(const char *path, u32 size[2]) {
+    u8 header[26];
+    FILE *file;
+    i32 width, height;
+
+    if (!(file = fopen(path, "rb"))) {
+        error("failed to read tileset image: '%s'", path);
+        return false;
+    }
+
+    if (fread(header, 1, sizeof(header), file) != sizeof(header) ||
+        header[0] != 'B' || header[1] != 'M') {
+        error("tileset image '%s' isn't a bitmap", path);
+        fclose(file);
+        return false;
+    }
+
+    fclose(file);
+
+    width = header[18] | header[19] << 8 | header[20] << 16 | (u32)header[21] << 24;
+    height = header[22] | header[23] << 8 | header[24] << 16 | (u32)header[25] << 24;
+
+    // top-down bitmaps have a negative height
+    if (height < 0)
+        height = -height;
+
+    size[0] = width;
+    size[1] = height;
+    return true;
+}
+
+/* Copies the value of an attribute of the XML tag starting at `tag` into
+ * `value`. Returns false if the tag doesn't have the attribute. */
+bool xml_attribute(const char *tag, const char *name, char *value, usize size) {
+    const char *end = strchr(tag, '>');
+    const char *at = tag;
+    usize name_len = strlen(name), len = 0;
+
+    while ((at = strstr(at + 1, name)) && (!end || at < end)) {
+        // skip matches that are the tail of a longer name
+        if (at[-1] != ' ' && at[-1] != '\t' && at[-1] != '\n')
+            continue;
+
+        if (at[name_len] != '=' || at[name_len + 1] != '"')
+            continue;
+
+        at += name_len + 2;
+
+        while (at[len] && at[len] != '"' && len + 1 < size) {
+            value[len] = at[len];
+            len++;
+        }
+
+        value[len] = '\0';
+        return true;
+    }
+
+    return false;
+}
+
+/* Reads an unsigned attribute, `fallback` when the tag doesn't have it. */
+u32 xml_attribute_u32(const char *tag, const char *name, u32 fallback) {
+    char value[32];
+
+    if (!xml_attribute(tag, name, value, sizeof(value)))
+        return fallback;
+
+    return strtoul(value, NULL, 10);
+}
+
+/* Reads the sprite size and image of a Tiled tileset (.tsx) file. How many
+ * sprites there are follows from the image's size, the counts written by
+ * Tiled are only checked against it. */
+bool tileset_read(const char *path, Tileset *tileset) {
+    const char *tag, *image, *slash;
+    char source[256], *text;
+    u32 bytes_read, pixels[2], dir_len;
+
+    if (!(text = read_binary(path, &bytes_read))) {
+        error("failed to read tileset: '%s'", path);
+        return false;
+    }
+
+    text = vrealloc(text, bytes_read + 1);
+    text[bytes_read] = '\0';
+
+    if (!(tag = strstr(text, "<tileset")) || !(image = strstr(tag, "<image"))) {
+        error("tileset '%s' has no image", path);
+        free(text);
+        return false;
+    }
+
+    tileset->tile_size[0] = xml_attribute_u32(tag, "tilewidth", 0);
+    tileset->tile_size[1] = xml_attribute_u32(tag, "tileheight", 0);
+
+    if (tileset->tile_size[0] == 0 || tileset->tile_size[1] == 0) {
+        error("tileset '%s' has no sprite size", path);
+        free(text);
+        return false;
+    }
+
+    // sprites are expected to be packed edge to edge, as the shaders assume
+    if (xml_attribute_u32(tag, "margin", 0) || xml_attribute_u32(tag, "spacing", 0)) {
+        error("tileset '%s' has a margin or spacing, which isn't supported", path);
+        free(text);
+        return false;
+    }
+
+    if (!xml_attribute(image, "source", source, sizeof(source))) {
+        error("tileset '%s' has no image source", path);
+        free(text);
+        return false;
+    }
+
+    // the image is relative to the tileset
+    slash = strrchr(path, '/');
+    dir_len = slash && source[0] != '/' ? slash - path + 1 : 0;
+    tileset->image = vmalloc(dir_len + strlen(source) + 1);
+    memcpy(tileset->image, path, dir_len);
+    strcpy(&tileset->image[dir_len], source);
+
+    if (!bmp_size(tileset->image, pixels)) {
+        free(text);
+        return false;
+    }
+
+    for (u32 axis = 0; axis < 2; axis++) {
+        tileset->sprites[axis] = pixels[axis] / tileset->tile_size[axis];
+
+        if (pixels[axis] % tileset->tile_size[axis] != 0)
+            warn("tileset image '%s' has pixels past its last sprite", tileset->image);
+    }
+
+    if (xml_attribute_u32(tag, "columns", tileset->sprites[0]) != tileset->sprites[0] ||
+        xml_attribute_u32(tag, "tilecount", tileset->sprites[0] * tileset->sprites[1]) !=
+            tileset->sprites[0] * tileset->sprites[1]) {
+        warn(
+            "tileset '%s' doesn't match its image, using %d by %d sprites",
+            path,
+            tileset->sprites[0],
+            tileset->sprites[1]
+        );
+    }
+
+    free(text);
+    return true;
+}
+
+/* Returns the `TileFlags` of every sprite of the tileset, marking the ones
+ * listed in a CSV file as solid. */
+u8 *solid_tiles_read(const char *path, u32 sprite_count) {
+    u8 *flags = vcalloc(sprite_count);
+    FILE *list;
+    i32 idx;
+
+    if (!(list = fopen(path, "r"))) {
+        warn("failed to read solid tiles: '%s', level has no solid tiles", path);
+        return flags;
+    }
+
+    while (fscanf(list, "%d", &idx) == 1) {
+        if (idx >= 0 && (u32)idx < sprite_count)
+            flags[idx] |= TILE_SOLID;
+        else
+            warn("solid tile %d is out of the tileset's bounds", idx);
+
+        // skip the delimiter
+        fgetc(list);
+    }
+
+    fclose(list);
+    return flags;
+}
+
+/* Reads a CSV file with a row of tiles per line. Cells past the end of a
+ * shorter row are left empty. */
+bool csv_layer_read(const char *path, CsvLayer *layer) {
+    u32 alloc_count = 0, count = 0, row_alloc_count = 0, columns = 0;
+    u32 *row_starts = NULL;
+    FILE *file;
+    i32 *cells = NULL, value = 0, sign = 1;
+    bool digits = false;
+
+    if (!(file = fopen(path, "r"))) {
+        error("failed to read level map: '%s'", path);
+        return false;
+    }
+
+    layer->size[0] = 0;
+    layer->size[1] = 0;
+
+    for (;;) {
+        int chr = fgetc(file);
+
+        if (chr == '-') {
+            sign = -1;
+        } else if (chr >= '0' && chr <= '9') {
+            value = value * 10 + (chr - '0');
+            digits = true;
+        } else if (chr == ',' || chr == '\n' || chr == EOF) {
+            // a cell ends at every delimiter, a row only if it has any
+            if (digits || chr == ',' || columns != 0) {
+                if (count == alloc_count) {
+                    alloc_count = alloc_count * 2 + 256;
+                    cells = vrealloc(cells, alloc_count * sizeof(i32));
+                }
+
+                cells[count++] = digits ? sign * value : -1;
+                columns++;
+            }
+
+            value = 0;
+            sign = 1;
+            digits = false;
+
+            if (chr != ',' && columns != 0) {
+                if (layer->size[1] == row_alloc_count) {
+                    row_alloc_count = row_alloc_count * 2 + 32;
+                    row_starts = vrealloc(row_starts, row_alloc_count * sizeof(u32));
+                }
+
+                row_starts[layer->size[1]++] = count - columns;
+
+                if (columns > layer->size[0])
+                    layer->size[0] = columns;
+
+                columns = 0;
+            }
+
+            if (chr == EOF)
+                break;
+        }
+
+        // anything else, like the carriage return of a line break, is skipped
+    }
+
+    fclose(file);
+
+    // spread the rows out to the width of the widest one
+    layer->cells = vmalloc(layer->size[0] * layer->size[1] * sizeof(i32) + 1);
+
+    for (u32 y = 0; y < layer->size[1]; y++) {
+        u32 start = row_starts[y];
+        u32 end = y + 1 < layer->size[1] ? row_starts[y + 1] : count;
+
+        for (u32 x = 0; x < layer->size[0]; x++)
+            layer->cells[y * layer->size[0] + x] = start + x < end ? cells[start + x] : -1;
+    }
+
+    free(row_starts);
+    free(cells);
+    return true;
+}
+
+/* Returns the tile of a layer at a cell, -1 for empty and outside cells. */
+i32 csv_layer_get(const CsvLayer *layer, u32 x, u32 y) {
+    if (x >= layer->size[0] || y >= layer->size[1])
+        return -1;
+
+    return layer->cells[y * layer->size[0] + x];
+}
+
+u64 align8(u64 offset) {
+    return (offset + 7) & ~(u64)7;
+}
+
+/* Writes `size` bytes followed by zeros up to the next multiple of 8. */
+bool write_aligned(FILE *file, const void *data, u64 size) {
+    static const u8 zeros[8];
+
+    if (size != 0 && fwrite(data, size, 1, file) != 1)
+        return false;
+
+    return fwrite(zeros, 1, align8(size) - size, file) == align8(size) - size;
+}
+
+i32 main(i32 argc, char **argv) {
+    LevelHeader header = {
+        .magic = LEVEL_MAGIC,
+        .version = LEVEL_VERSION,
+        .chunk_size = CHUNK_SIZE,
+    };
+    Tileset tileset;
+    CsvLayer *layers;
+    LevelChunk *chunks;
+    LevelUv *uvs;
+    TileInstance *tiles = NULL;
+    u32 tile_count = 0, tile_alloc_count = 0, sprite_count, chunk_count;
+    u64 tiles_offset;
+    u8 *solid, *flags;
+    FILE *out;
+
+    if (argc < 5) {
+        error("usage: %s OUTPUT TILESET SOLID_TILES LAYER...", argv[0]);
+        return 1;
+    }
+
+    if (!tileset_read(argv[2], &tileset))
+        return 1;
+
+    for (u32 axis = 0; axis < 2; axis++) {
+        header.atlas_size[axis] = tileset.sprites[axis];
+        header.tile_size[axis] = tileset.tile_size[axis];
+    }
+
+    // sprites are indexed in 16 bits
+    if ((u64)header.atlas_size[0] * header.atlas_size[1] > 0x10000) {
+        error(
+            "tileset has %d by %d sprites, more than fit",
+            header.atlas_size[0],
+            header.atlas_size[1]
+        );
+        return 1;
+    }
+
+    sprite_count = header.atlas_size[0] * header.atlas_size[1];
+    solid = solid_tiles_read(argv[3], sprite_count);
+
+    header.layer_count = argc - 4;
+
+    // layers are indexed in 16 bits
+    if (header.layer_count > 0xFFFF) {
+        error("level has %d layers, more than fit", header.layer_count);
+        return 1;
+    }
+
+    layers = vmalloc(header.layer_count * sizeof(CsvLayer));
+
+    for (u32 idx = 0; idx < header.layer_count; idx++) {
+        if (!csv_layer_read(argv[4 + idx], &layers[idx]))
+            return 1;
+
+        for (u32 axis = 0; axis < 2; axis++) {
+            if (layers[idx].size[axis] > header.size[axis])
+                header.size[axis] = layers[idx].size[axis];
+        }
+    }
+
+    // tile positions are stored in 16 bits
+    if (header.size[0] > 0xFFFF || header.size[1] > 0xFFFF) {
+        error("level is %d by %d tiles, more than fit", header.size[0], header.size[1]);
+        return 1;
+    }
+
+    header.chunks[0] = (header.size[0] + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    header.chunks[1] = (header.size[1] + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    chunk_count = header.chunks[0] * header.chunks[1] * header.layer_count;
+
+    flags = vcalloc(header.size[0] * header.size[1] + 1);
+    chunks = vcalloc(chunk_count * sizeof(LevelChunk) + 1);
+
+    // group the tiles of every chunk together so it's a single range
+    for (u32 layer = 0; layer < header.layer_count; layer++) {
+        for (u32 cy = 0; cy < header.chunks[1]; cy++) {
+            for (u32 cx = 0; cx < header.chunks[0]; cx++) {
+                LevelChunk *chunk = &chunks[(layer * header.chunks[1] + cy) * header.chunks[0] + cx];
+
+                chunk->offset = tile_count;
+
+                for (u32 y = cy * CHUNK_SIZE; y < (cy + 1) * CHUNK_SIZE; y++) {
+                    for (u32 x = cx * CHUNK_SIZE; x < (cx + 1) * CHUNK_SIZE; x++) {
+                        i32 idx = csv_layer_get(&layers[layer], x, y);
+
+                        if (idx == -1)
+                            continue;
+
+                        if (idx < 0 || (u32)idx >= sprite_count) {
+                            warn("tile %d at %d, %d is out of the tileset's bounds", idx, x, y);
+                            continue;
+                        }
+
+                        if (tile_count == tile_alloc_count) {
+                            tile_alloc_count = tile_alloc_count * 2 + 256;
+                            tiles = vrealloc(tiles, tile_alloc_count * sizeof(TileInstance));
+                        }
+
+                        tiles[tile_count++] = (TileInstance) {
+                            .pos = { x, y },
+                            .tile = idx,
+                            .layer = layer,
+                        };
+
+                        flags[y * header.size[0] + x] |= solid[idx];
+                    }
+                }
+
+                chunk->tile_count = tile_count - chunk->offset;
+            }
+        }
+    }
+
+    uvs = vmalloc(sprite_count * sizeof(LevelUv) + 1);
+
+    for (u32 idx = 0; idx < sprite_count; idx++) {
+        u32 column = idx % header.atlas_size[0];
+        u32 row = idx / header.atlas_size[0];
+
+        uvs[idx] = (LevelUv) {
+            .min = {
+                (f32)column / (f32)header.atlas_size[0],
+                (f32)row / (f32)header.atlas_size[1],
+            },
+            .max = {
+                (f32)(column + 1) / (f32)header.atlas_size[0],
+                (f32)(row + 1) / (f32)header.atlas_size[1],
+            },
+        };
+    }
+
+    header.tileset_offset = align8(sizeof(LevelHeader));
+    header.flags_offset = header.tileset_offset + align8(strlen(tileset.image) + 1);
+    header.uvs_offset = header.flags_offset + align8(header.size[0] * header.size[1]);
+    header.chunks_offset = header.uvs_offset + align8(sprite_count * sizeof(LevelUv));
+    tiles_offset = header.chunks_offset + align8(chunk_count * sizeof(LevelChunk));
+
+    // chunks point at their tiles by file offset
+    for (u32 idx = 0; idx < chunk_count; idx++)
+        chunks[idx].offset = tiles_offset + chunks[idx].offset * sizeof(TileInstance);
+
+    if (!(out = fopen(argv[1], "wb"))) {
+        error("failed to create level: '%s'", argv[1]);
+        return 1;
+    }
+
+    if (!write_aligned(out, &header, sizeof(LevelHeader)) ||
+        !write_aligned(out, tileset.image, strlen(tileset.image) + 1) ||
+        !write_aligned(out, flags, header.size[0] * header.size[1]) ||
+        !write_aligned(out, uvs, sprite_count * sizeof(LevelUv)) ||
+        !write_aligned(out, chunks, chunk_count * sizeof(LevelChunk)) ||
+        !write_aligned(out, tiles, tile_count * sizeof(TileInstance))) {
+        error("failed to write level: '%s'", argv[1]);
+        fclose(out);
+        remove(argv[1]);
+        return 1;
+    }
+
+    fclose(out);
+
+    info(
+        "compiled %d layers of %d by %d tiles into '%s', %d tiles in %d chunks",
+        header.layer_count,
+        header.size[0],
+        header.size[1],
+        argv[1],
+        tile_count,
+        chunk_count
+    );
+
+    for (u32 idx = 0; idx < header.layer_count; idx++)
+        free(layers[idx].cells);
+
+    free(layers);
+    free(tileset.image);
+    free(tiles);
+    free(uvs);
+    free(chunks);
+    free(flags);
+    free(solid);
+
+    return 0;
+}